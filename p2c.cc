@@ -1,4 +1,7 @@
 /** Network topology
+ *
+ * Default layout with --edgeNodes=4; every edge node receives
+ * --flowsPerNode TCP flows from the edge nodes on the other side.
  *
  *    100Mb/s,0.5ms|                    |100Mb/s,0.5ms
  * n1--------------|                    |--------------n5
@@ -16,319 +19,224 @@
 #include "ns3/core-module.h"
 #include "ns3/network-module.h"
 #include "ns3/internet-module.h"
-#include "ns3/flow-monitor-helper.h"
 #include "ns3/point-to-point-module.h"
 #include "ns3/applications-module.h"
 #include "ns3/traffic-control-module.h"
 
+#include "red-common.h"
+#include "red-harness.h"
+#include "red-mpi.h"
+#include "red-run-summary.h"
+
 using namespace ns3;
 
 NS_LOG_COMPONENT_DEFINE ("Red(a)");
 
-uint32_t checkTimes;
-double avgQueueSize;
 uint32_t port = 8888;
 constexpr uint32_t packetSize = 1000 - 42;
+// Stream of the --startJitter offsets, clear of the discs' (0, 1), the size
+// mix's (100 on) and the workload's (1 << 20 on)
+constexpr int64_t jitterStream = 50;
 
-std::stringstream filePlotQueueA;
-std::stringstream filePlotQueueB;
-std::stringstream filePlotQueueAAvg;
-std::stringstream filePlotQueueBAvg;
-std::stringstream filePlotPacketArriveA;
-std::stringstream filePlotPacketArriveB;
-std::stringstream filePlotPacketDropA;
-std::stringstream filePlotPacketDropB;
-
-// The sequence number is in bytes not packets
-void EnqueueAtRedA(Ptr<const QueueDiscItem> item) {
-    TcpHeader tcp;
-    Ptr<Packet> pkt = item->GetPacket();
-    pkt->PeekHeader(tcp);
-
-    std::ofstream fPlotPacketArrive(filePlotPacketArriveA.str().c_str(), std::ios::out | std::ios::app);
-    fPlotPacketArrive << Simulator::Now().GetSeconds() << " " << tcp.GetSequenceNumber() << std::endl;
-    fPlotPacketArrive.close();
-}
-
-void EnqueueAtRedB(Ptr<const QueueDiscItem> item) {
-    TcpHeader tcp;
-    Ptr<Packet> pkt = item->GetPacket();
-    pkt->PeekHeader(tcp);
-
-    std::ofstream fPlotPacketArrive(filePlotPacketArriveB.str().c_str(), std::ios::out | std::ios::app);
-    fPlotPacketArrive << Simulator::Now().GetSeconds() << " " << tcp.GetSequenceNumber() << std::endl;
-    fPlotPacketArrive.close();
-}
-
-
-void DroppedAtRedA(Ptr<const QueueDiscItem> item) {
-    TcpHeader tcp;
-    Ptr<Packet> pkt = item->GetPacket();
-    pkt->PeekHeader(tcp);
-
-    std::ofstream fPlotPacketDrop(filePlotPacketDropA.str().c_str(), std::ios::out | std::ios::app);
-    fPlotPacketDrop << Simulator::Now().GetSeconds() << " " << tcp.GetSequenceNumber() << std::endl;
-    fPlotPacketDrop.close();
-}
-
-void DroppedAtRedB(Ptr<const QueueDiscItem> item) {
-    TcpHeader tcp;
-    Ptr<Packet> pkt = item->GetPacket();
-    pkt->PeekHeader(tcp);
-
-    std::ofstream fPlotPacketDrop(filePlotPacketDropB.str().c_str(), std::ios::out | std::ios::app);
-    fPlotPacketDrop << Simulator::Now().GetSeconds() << " " << tcp.GetSequenceNumber() << std::endl;
-    fPlotPacketDrop.close();
-}
-
-
-//This code is fine for printing average and actual queue size
-void CheckQueueASize(Ptr<QueueDisc> queue) {
-    uint32_t qsize = StaticCast<RedQueueDisc>(queue)->GetQueueSize();
-    avgQueueSize += qsize;
-    checkTimes++;
-
-    // check queue size every 1/100 of a second
-    Simulator::Schedule(Seconds(0.01), &CheckQueueASize, queue);
-
-    std::ofstream fPlotQueue(filePlotQueueA.str().c_str(), std::ios::out | std::ios::app);
-    fPlotQueue << Simulator::Now().GetSeconds() << " " << qsize << std::endl;
-    fPlotQueue.close();
-
-    std::ofstream fPlotQueueAvg(filePlotQueueAAvg.str().c_str(), std::ios::out | std::ios::app);
-    fPlotQueueAvg << Simulator::Now().GetSeconds() << " " << avgQueueSize / checkTimes << std::endl;
-    fPlotQueueAvg.close();
-}
-
-void CheckQueueBSize(Ptr<QueueDisc> queue) {
-    uint32_t qsize = StaticCast<RedQueueDisc>(queue)->GetQueueSize();
-    avgQueueSize += qsize;
-    checkTimes++;
-
-    Simulator::Schedule(Seconds(0.01), &CheckQueueBSize, queue);
-
-    std::ofstream fPlotQueue(filePlotQueueB.str().c_str(), std::ios::out | std::ios::app);
-    fPlotQueue << Simulator::Now().GetSeconds() << " " << qsize << std::endl;
-    fPlotQueue.close();
-
-    std::ofstream fPlotQueueAvg(filePlotQueueBAvg.str().c_str(), std::ios::out | std::ios::app);
-    fPlotQueueAvg << Simulator::Now().GetSeconds() << " " << avgQueueSize / checkTimes << std::endl;
-    fPlotQueueAvg.close();
-}
+RedHarness harness ("P2c");
 
 int main (int argc, char *argv[])
 {
     LogComponentEnable ("RedQueueDisc", LOG_LEVEL_INFO);
 
-    std::string pathOut = "P2c";;
-    bool writeForPlot = true;
-    bool writePcap = false;
-    bool flowMonitor = false;
-
-    uint32_t runNumber = 0;
-    uint32_t maxPackets = 400;
-    uint32_t meanPktSize = 500;
-    std::string redLinkDataRate = "45Mbps";
-    std::string redLinkDelay = "2ms";
-    double qw = 0.002;
-    double minTh = 5;
-    double maxTh = 15;
-    double stopTime = 1.0;
+    bool mpi = false;
+    RedParams &red = harness.red;
+    red.queueLimit = 400;
+    uint32_t edgeNodes = 4;
+    uint32_t flowsPerNode = 4;
+    std::string sourceRate = "100Mbps";
+    uint32_t tcpBufferSize = 131072;
 
     //Will only save in the directory if enable opts below
     CommandLine cmd;
-    cmd.AddValue ("runNumber", "run number for random variable generation", runNumber);
-    cmd.AddValue ("pathOut", "Path to save results from --writeForPlot/--writePcap/--writeFlowMonitor", pathOut);
-    cmd.AddValue ("maxPackets", "Max packets allowed in the device queue", maxPackets);
-    cmd.AddValue ("writeForPlot", "<0/1> to write results for plot (gnuplot)", writeForPlot);
-    cmd.AddValue ("writePcap", "<0/1> to write results in pcapfile", writePcap);
-    cmd.AddValue ("writeFlowMonitor", "<0/1> to enable Flow Monitor and write their results", flowMonitor);
+    harness.AddValues (cmd);
+    cmd.AddValue ("mpi", "<0/1> run NA's side and NB's side on two MPI ranks (see red-mpi.h)", mpi);
+    cmd.AddValue ("edgeNodes", "Edge nodes on each side of the NA-NB bottleneck", edgeNodes);
+    cmd.AddValue ("flowsPerNode", "TCP flows into each edge node from the other side", flowsPerNode);
+    cmd.AddValue ("sourceRate", "OnOff data rate of every flow", sourceRate);
+    cmd.AddValue ("tcpBufferSize", "TCP send and receive buffer per socket (bytes)", tcpBufferSize);
+
+    // Parsed before the defaults below so the RED parameters can be swept
+    cmd.Parse (argc, argv);
+    harness.Configure ();
+
+    // NA's side on rank 0, NB's side on the last rank; with one rank this
+    // is the serial run under the distributed simulator
+    if (mpi)
+    {
+        harness.UseMpi (&argc, &argv);
+        NS_ABORT_MSG_IF (GetMpiSize () > 2, "p2c has two sides, run it on at most two ranks");
+    }
+    uint32_t ranks = GetMpiSize ();
 
     //RED params
     NS_LOG_INFO ("Set RED params");
-    Config::SetDefault("ns3::TcpL4Protocol::SocketType", StringValue("ns3::TcpNewReno"));
-    Config::SetDefault("ns3::TcpSocket::SegmentSize", UintegerValue(packetSize));
-    Config::SetDefault("ns3::TcpSocket::DelAckCount", UintegerValue(1));
-    Config::SetDefault ("ns3::RedQueueDisc::Mode", StringValue ("QUEUE_DISC_MODE_PACKETS"));
-    Config::SetDefault ("ns3::RedQueueDisc::MeanPktSize", UintegerValue (meanPktSize));
-    Config::SetDefault ("ns3::RedQueueDisc::Wait", BooleanValue (true));
-    Config::SetDefault ("ns3::RedQueueDisc::Gentle", BooleanValue (true));
-    Config::SetDefault ("ns3::RedQueueDisc::QW", DoubleValue (qw));
-    Config::SetDefault ("ns3::RedQueueDisc::MinTh", DoubleValue (minTh));
-    Config::SetDefault ("ns3::RedQueueDisc::MaxTh", DoubleValue (maxTh));
-    Config::SetDefault ("ns3::RedQueueDisc::LinkBandwidth", StringValue (redLinkDataRate));
-    Config::SetDefault ("ns3::RedQueueDisc::LinkDelay", StringValue (redLinkDelay));
-    Config::SetDefault ("ns3::RedQueueDisc::QueueLimit", UintegerValue (maxPackets));
+    harness.ApplyDefaults (packetSize);
+    Config::SetDefault ("ns3::TcpSocket::SndBufSize", UintegerValue (tcpBufferSize));
+    Config::SetDefault ("ns3::TcpSocket::RcvBufSize", UintegerValue (tcpBufferSize));
 
+    // Again, so --ns3::RedQueueDisc::... and --ns3::TcpSocket::... attribute
+    // overrides win over the defaults above
     cmd.Parse (argc, argv);
 
-    SeedManager::SetSeed(1);
-    SeedManager::SetRun(runNumber);
+    NS_ABORT_MSG_IF (edgeNodes == 0 || flowsPerNode == 0, "need at least one edge node and one flow per node");
+    NS_ABORT_MSG_IF (2 * edgeNodes + 1 > 65535, "too many links for the 10.x.y.0/24 address plan");
 
-    //Create nodes
+    //Create nodes: N1..N<edgeNodes> on the NA side, the rest on the NB side
     NS_LOG_INFO ("Create nodes");
+    uint32_t nEdge = 2 * edgeNodes;
+    uint32_t nLinks = nEdge + 1;
     NodeContainer c;
-    NodeContainer n[9];
-    c.Create (10);
-    Names::Add ( "N1", c.Get (0));
-    Names::Add ( "N2", c.Get (1));
-    Names::Add ( "N3", c.Get (2));
-    Names::Add ( "N4", c.Get (3));
-    Names::Add ( "N5", c.Get (4));
-    Names::Add ( "N6", c.Get (5));
-    Names::Add ( "N7", c.Get (6));
-    Names::Add ( "N8", c.Get (7));
-    Names::Add ( "NA", c.Get (8));
-    Names::Add ( "NB", c.Get (9));
-
-    for(uint8_t i=0;i<8;i++) {
-        if (i < 4)
-        n[i] = NodeContainer(c.Get(i), c.Get(8));
-        else
-        n[i] = NodeContainer(c.Get(i), c.Get(9));
+    for (uint32_t i = 0; i < nEdge + 2; i++) {
+        bool sideB = i == nEdge + 1 || (i >= edgeNodes && i < nEdge);
+        c.Add (CreateObject<Node> (sideB ? ranks - 1 : 0));
+    }
+    Ptr<Node> nodeA = c.Get (nEdge);
+    Ptr<Node> nodeB = c.Get (nEdge + 1);
+    for (uint32_t i = 0; i < nEdge; i++) {
+        std::stringstream name;
+        name << "N" << i + 1;
+        Names::Add (name.str (), c.Get (i));
     }
-    n[8] = NodeContainer(c.Get(8), c.Get(9));
+    Names::Add ( "NA", nodeA);
+    Names::Add ( "NB", nodeB);
+
+    // n[i] is edge node i and its router, n[nEdge] the bottleneck
+    std::vector<NodeContainer> n (nLinks);
+    for (uint32_t i = 0; i < nEdge; i++)
+        n[i] = NodeContainer(c.Get(i), i < edgeNodes ? nodeA : nodeB);
+    n[nEdge] = NodeContainer(nodeA, nodeB);
 
     //Install internet stack on all nodes
     NS_LOG_INFO ("Install internet stack on all nodes.");
     InternetStackHelper internet;
     internet.Install (c);
 
-    //Create channels and install devices
+    //Create channels and install devices, edge delays repeat per side
     NS_LOG_INFO ("Create channels");
     PointToPointHelper p2p;
-    std::string delay[9] = {"0.5ms", "1ms", "3ms", "5ms", "0.5ms", "1ms", "5ms", "2ms", "2ms"};
-    NetDeviceContainer devn[9];
-    for (int i = 0; i < 9; i++) {
-        if(i != 8)
-            p2p.SetDeviceAttribute("DataRate", StringValue("100Mbps"));
-        else
-            p2p.SetDeviceAttribute("DataRate", StringValue("45Mbps"));
-        p2p.SetChannelAttribute("Delay", StringValue(delay[i]));
+    const std::string delayA[4] = {"0.5ms", "1ms", "3ms", "5ms"};
+    const std::string delayB[4] = {"0.5ms", "1ms", "5ms", "2ms"};
+    std::vector<NetDeviceContainer> devn (nLinks);
+    p2p.SetDeviceAttribute("DataRate", StringValue("100Mbps"));
+    for (uint32_t i = 0; i < nEdge; i++) {
+        p2p.SetChannelAttribute("Delay", StringValue(i < edgeNodes ? delayA[i % 4] : delayB[(i - edgeNodes) % 4]));
         devn[i] = p2p.Install(n[i]);
     }
+    p2p.SetDeviceAttribute("DataRate", StringValue(red.linkRate));
+    p2p.SetChannelAttribute("Delay", StringValue(red.linkDelay));
+    devn[nEdge] = p2p.Install(n[nEdge]);
 
-    //Install traffic controller to Red Link
+    //Install traffic controller to Red Link, or the --aqm alternative
     TrafficControlHelper tchRed;
-    tchRed.SetRootQueueDisc("ns3::RedQueueDisc");
-    Ptr<QueueDisc> redQueueA = (tchRed.Install(devn[8].Get(0))).Get(0);
-    Ptr<QueueDisc> redQueueB = (tchRed.Install(devn[8].Get(1))).Get(0);
-
-    //Setup traces
-    redQueueA->TraceConnectWithoutContext("Enqueue", MakeCallback(&EnqueueAtRedA));
-    redQueueA->TraceConnectWithoutContext("Drop", MakeCallback(&DroppedAtRedA));
-
-    redQueueB->TraceConnectWithoutContext("Enqueue", MakeCallback(&EnqueueAtRedB));
-    redQueueB->TraceConnectWithoutContext("Drop", MakeCallback(&DroppedAtRedB));
+    SetRootAqm (tchRed, red.aqm, red, red.linkRate, red.linkDelay);
+    QueueDiscContainer redQueues = tchRed.Install(devn[nEdge]);
 
+    //Setup traces, gate A is NA's side of the bottleneck and B is NB's;
+    //each rank watches the gates of its own routers
+    if (IsLocalNode(nodeA))
+        harness.monitor.Add(redQueues.Get(0), "A");
+    if (IsLocalNode(nodeB))
+        harness.monitor.Add(redQueues.Get(1), "B");
 
-    //Assign IP Address
+    //Assign IP Address, one /24 per link starting at 10.1.1.0
     NS_LOG_INFO ("Assign IP Addresses");
     Ipv4AddressHelper ipv4;
-    Ipv4InterfaceContainer ip4[9];
+    std::vector<Ipv4InterfaceContainer> ip4 (nLinks);
 
-    for (uint8_t i=0;i<9;i++) {
-        std::stringstream ip;
-        ip << "10.1." << i+1 << ".0";
-        ipv4.SetBase(ip.str().c_str(), "255.255.255.0");
+    ipv4.SetBase("10.1.1.0", "255.255.255.0");
+    for (uint32_t i = 0; i < nLinks; i++) {
         ip4[i] = ipv4.Assign(devn[i]);
+        ipv4.NewNetwork();
     }
 
     //Setup routing tables
     Ipv4GlobalRoutingHelper::PopulateRoutingTables ();
 
     ApplicationContainer sources;
-
-    //Install Sources
-    OnOffHelper sourceHelper("ns3::TcpSocketFactory", Address());
-    sourceHelper.SetAttribute("OnTime", StringValue("ns3::ConstantRandomVariable[Constant=1]"));
-    sourceHelper.SetAttribute("OffTime", StringValue("ns3::ConstantRandomVariable[Constant=0]"));
-    sourceHelper.SetAttribute("DataRate", DataRateValue(DataRate("100Mbps")));
-    sourceHelper.SetAttribute("PacketSize", UintegerValue(packetSize));
-    for (int i = 0; i < 8; ++i) {
-        for (int j = 0; j < 4; ++j) {
-            AddressValue remote(InetSocketAddress(ip4[i].GetAddress(0), port));
-            sourceHelper.SetAttribute("Remote", remote);
-            if (i < 4)
-                sources.Add(sourceHelper.Install(n[j + 4].Get(0)));
-            else
-                sources.Add(sourceHelper.Install(n[j].Get(0)));
-            sources.Start(Seconds(0));
+    uint64_t rssBeforeFlows = GetResidentBytes ();
+
+    // Each destination takes its flowsPerNode senders from a window on the
+    // other side; with flowsPerNode == edgeNodes that is every node there.
+    // Every rank draws every start offset from a fixed stream, so a source
+    // starts at the same time as in the serial run. Sources are constant
+    // OnOff unless --workload says otherwise.
+    Ptr<UniformRandomVariable> jitter;
+    if (harness.startJitter > 0) {
+        jitter = CreateObject<UniformRandomVariable> ();
+        jitter->SetStream (jitterStream);
+    }
+    for (uint32_t i = 0; i < nEdge; ++i) {
+        InetSocketAddress remote(ip4[i].GetAddress(0), port);
+        uint32_t otherSide = i < edgeNodes ? edgeNodes : 0;
+        for (uint32_t j = 0; j < flowsPerNode; ++j) {
+            uint32_t src = otherSide + (j + i * flowsPerNode) % edgeNodes;
+            double start = jitter ? jitter->GetValue(0, harness.startJitter) : 0;
+            if (!IsLocalNode(n[src].Get(0)))
+                continue;
+            ApplicationContainer source = harness.workload.Install(n[src].Get(0), remote, sourceRate, packetSize);
+            source.Start(Seconds(start));
+            sources.Add(source);
         }
     }
 
-    sources.Start(Seconds(0));
-
     //Install Sinks
     ApplicationContainer sinks;
 
     PacketSinkHelper sinkHelper("ns3::TcpSocketFactory",
                                 InetSocketAddress(Ipv4Address::GetAny(), port));
-    for (int i = 0; i < 8; ++i)
-        sinks.Add(sinkHelper.Install(n[i].Get(0)));
+    for (uint32_t i = 0; i < nEdge; ++i)
+        if (IsLocalNode(n[i].Get(0)))
+            sinks.Add(sinkHelper.Install(n[i].Get(0)));
 
     sinks.Start(Seconds(0));
 
-    if (writePcap)
-    {
-        PointToPointHelper ptp;
-        std::stringstream stmp;
-        stmp << pathOut << "/red";
-        ptp.EnablePcapAll (stmp.str ().c_str ());
-    }
-
-    Ptr<FlowMonitor> flowmon;
-    if (flowMonitor)
-    {
-        FlowMonitorHelper flowmonHelper;
-        flowmon = flowmonHelper.InstallAll ();
-    }
-
-    //Write output
-    if (writeForPlot) {
-        filePlotQueueA << pathOut << "/" << "redQueueA.plot";
-        filePlotQueueAAvg << pathOut << "/" << "redQueueAAvg.plot";
-        filePlotQueueB << pathOut << "/" << "redQueueB.plot";
-        filePlotQueueBAvg << pathOut << "/" << "redQueueBAvg.plot";
-        filePlotPacketArriveA << pathOut << "/" << "PacketNumA.plot";
-        filePlotPacketArriveB << pathOut << "/" << "PacketNumB.plot";
-        filePlotPacketDropA << pathOut << "/" << "PacketDropA.plot";
-        filePlotPacketDropB << pathOut << "/" << "PacketDropB.plot";
-
-        remove(filePlotQueueA.str().c_str());
-        remove(filePlotQueueB.str().c_str());
-        remove(filePlotQueueAAvg.str().c_str());
-        remove(filePlotQueueBAvg.str().c_str());
-        Simulator::ScheduleNow(&CheckQueueASize, redQueueA);
-        Simulator::ScheduleNow(&CheckQueueBSize, redQueueB);
+    // One UDP stream of the --sizeMix sizes from every edge node to the one
+    // opposite it
+    if (harness.sizeMix.IsEnabled ()) {
+        for (uint32_t i = 0; i < nEdge; ++i) {
+            if (!IsLocalNode(n[i].Get(0))) {
+                harness.sizeMix.Skip();
+                continue;
+            }
+            harness.sizeMix.Install(n[i].Get(0), ip4[(i + edgeNodes) % nEdge].GetAddress(0), 0);
+            harness.sizeMix.InstallSink(n[i].Get(0));
+        }
     }
 
-    Simulator::Stop(Seconds(stopTime));
-    Simulator::Run();
-
-    uint32_t totalBytes = 0;
+    uint32_t nFlows = sources.GetN ();
+    NS_LOG_INFO (nFlows << " flows, " << GetBytesPerFlow (rssBeforeFlows, GetResidentBytes (), nFlows) << " bytes per flow at setup");
 
-    for (uint32_t i = 0; i < sinks.GetN(); ++i) {
-        Ptr<Application> app = sinks.Get(i);
-        Ptr<PacketSink> pktSink = DynamicCast<PacketSink>(app);
-        uint32_t received = pktSink->GetTotalRx();
-        std::cout << "\tSink\t" << i << "\tBytes\t" << received << std::endl;
-        totalBytes += received;
-    }
+    harness.Start (sinks, TraceFileWriter::COL_SEQ, TraceFileWriter::COL_SEQ);
+    if (!harness.Run ())
+        return harness.GetForkStatus ();
+    harness.Finish ();
 
-    std::cout << std::endl << "\tTotal\t\tBytes\t" << totalBytes << std::endl;
+    // Sockets and their buffers are created once the flows start, so the
+    // per-flow footprint is measured again after the run
+    uint64_t rssAfterRun = GetResidentBytes ();
+    double bytesPerFlow = GetBytesPerFlow (rssBeforeFlows, rssAfterRun, nFlows);
+    std::cout << "\tFlows\t" << nFlows << "\tMemory per flow\t" << bytesPerFlow << " bytes" << std::endl;
 
-    std::cout << "Done" << std::endl;
-
-    if (flowMonitor)
+    // Under --mpi rank 0 combines what every rank measured on its side
+    if (harness.IsWritingSummary ())
     {
-        std::stringstream stmp;
-        stmp << pathOut << "/red.flowmon";
-
-        flowmon->SerializeToXmlFile (stmp.str ().c_str (), false, false);
+        RunSummary summary;
+        harness.Report (summary);
+        summary.Add ("flows", nFlows);
+        summary.Add ("bytesPerFlow", bytesPerFlow);
+        // Lets redaqm.py turn queue lengths into queueing delay
+        summary.Add ("linkBps", DataRate (red.linkRate).GetBitRate ());
+        summary.Add ("packetBytes", packetSize + 40);
+        harness.WriteSummary (summary);
     }
 
-    Simulator::Destroy ();
+    harness.Close ();
 
     return 0;
 }
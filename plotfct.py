@@ -0,0 +1,87 @@
+#!/usr/bin/env python3
+"""Plots the flow completion times written by --writeFct.
+
+    python3 plotfct.py P2a/fct.txt
+
+Prints the per-bucket percentiles (B lines). With --fctPerFlow runs,
+left: CDF of the completion times per size bucket; right: every flow's
+slowdown against its size. Without per-flow lines: the p99 completion
+time of every bucket per --fctWindow (T lines).
+"""
+
+import bisect
+import sys
+from collections import defaultdict
+
+import matplotlib.pyplot as plt
+
+
+def read_fct(path):
+    buckets = []
+    flows = []
+    windows = defaultdict(list)
+    running = 0
+    for line in open(path):
+        f = line.split()
+        if f[0] == "B":
+            buckets.append((f[1], int(f[2]), [float(v) for v in f[3:]]))
+        elif f[0] == "F":
+            start, last, size = float(f[1]), float(f[3]), int(f[4])
+            flows.append((size, last - start, float(f[5])))
+        elif f[0] == "T":
+            windows[f[2]].append((float(f[1]), float(f[5])))
+        elif f[0] == "I":
+            running += 1
+    return buckets, flows, windows, running
+
+
+def bucket_of(bounds, names, size):
+    return names[bisect.bisect_left(bounds, size)]
+
+
+def main():
+    path = sys.argv[1] if len(sys.argv) > 1 else "./P2a/fct.txt"
+    buckets, flows, windows, running = read_fct(path)
+    if not buckets:
+        sys.exit("no buckets in %s" % path)
+
+    print("bucket\tflows\tp50 ms\tp99 ms\tslowdown p50\tslowdown p99")
+    for name, count, v in buckets:
+        print("%s\t%d\t%.3f\t%.3f\t%.2f\t%.2f" % (name, count, v[0] * 1e3, v[2] * 1e3, v[5], v[6]))
+    print("still running at the end\t%d" % running)
+
+    names = [name for name, _, _ in buckets]
+    bounds = [int(name) for name in names if not name.startswith("Over") and name != "All"]
+    if flows:
+        fcts = defaultdict(list)
+        for size, fct, _ in flows:
+            fcts[bucket_of(bounds, names, size)].append(fct)
+        plt.subplot(121)
+        for name in names:
+            values = sorted(fcts[name])
+            if values:
+                plt.plot([v * 1e3 for v in values], [(k + 1) / len(values) for k in range(len(values))],
+                         label=name)
+        plt.xscale('log')
+        plt.xlabel('Flow completion time (ms)')
+        plt.ylabel('CDF')
+        plt.legend(title='Bytes up to')
+
+        plt.subplot(122)
+        plt.scatter([size for size, _, _ in flows], [slowdown for _, _, slowdown in flows], s=4)
+        plt.xscale('log')
+        plt.yscale('log')
+        plt.xlabel('Flow size (bytes)')
+        plt.ylabel('Slowdown')
+    else:
+        for name in names:
+            if windows[name]:
+                plt.plot([t for t, _ in windows[name]], [p99 * 1e3 for _, p99 in windows[name]], label=name)
+        plt.xlabel('Time')
+        plt.ylabel('p99 flow completion time (ms)')
+        plt.legend(title='Bytes up to')
+    plt.show()
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,58 @@
+#!/usr/bin/env python3
+"""Plots the per-flow table written by --writeFlowTable.
+
+    python3 plotflows.py P2c/flows.txt
+
+Top: delivered throughput of every flow per bin. Bottom: the Jain
+fairness index of each bin.
+"""
+
+import sys
+from collections import defaultdict
+
+import matplotlib.pyplot as plt
+
+
+def read_flows(path):
+    width = 1.0
+    names = {}
+    bins = []
+    jain = []
+    delivered = defaultdict(dict)
+    for line in open(path):
+        f = line.split()
+        if f[0] == "W":
+            width = float(f[1])
+        elif f[0] == "F":
+            names[int(f[1])] = "%s:%s > %s:%s" % (f[2], f[3], f[4], f[5])
+        elif f[0] == "B":
+            bins.append(float(f[1]))
+            jain.append(float(f[2]))
+        elif f[0] == "R":
+            delivered[int(f[2])][float(f[1])] = int(f[5])
+    return width, names, bins, jain, delivered
+
+
+def main():
+    path = sys.argv[1] if len(sys.argv) > 1 else "./p2c/flows.txt"
+    width, names, bins, jain, delivered = read_flows(path)
+
+    plt.subplot(211)
+    for flow in sorted(delivered):
+        series = delivered[flow]
+        plt.plot(bins, [series.get(t, 0) * 8 / width / 1e6 for t in bins], label=names.get(flow, str(flow)))
+    plt.ylabel('Delivered (Mb/s)')
+    plt.xlabel('Time')
+    if len(delivered) <= 16:
+        plt.legend(fontsize='small')
+
+    plt.subplot(212)
+    plt.plot(bins, jain, '.-')
+    plt.ylim(0, 1.05)
+    plt.ylabel('Jain index')
+    plt.xlabel('Time')
+    plt.show()
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,70 @@
+#!/usr/bin/env python3
+"""Plots the per-link heatmaps written by --writeLinks.
+
+    python3 plotlinks.py P2c/links.txt
+
+Top: utilization of every link per bin. Bottom: its mean backlog in
+packets. Rows are links ("from->to"), the most utilised at the top.
+"""
+
+import sys
+
+import matplotlib.pyplot as plt
+
+
+def read_links(path):
+    width = 1.0
+    names = {}
+    bins = []
+    util = []
+    backlog = []
+    top = []
+    for line in open(path):
+        f = line.split()
+        if f[0] == "W":
+            width = float(f[1])
+        elif f[0] == "L":
+            names[int(f[1])] = "%s->%s" % (f[2], f[3])
+        elif f[0] == "U":
+            bins.append(float(f[1]))
+            util.append([float(v) for v in f[2:]])
+        elif f[0] == "Q":
+            backlog.append([float(v) for v in f[2:]])
+        elif f[0] == "T":
+            top.append((int(f[2]), float(f[3]), float(f[4])))
+    return width, names, bins, util, backlog, top
+
+
+def main():
+    path = sys.argv[1] if len(sys.argv) > 1 else "./p2c/links.txt"
+    width, names, bins, util, backlog, top = read_links(path)
+    if not bins:
+        sys.exit("no bins in %s" % path)
+
+    for rank, (link, u, b) in enumerate(top, 1):
+        print("%d\t%s\tutilization %.3f\tbacklog %.1f" % (rank, names.get(link, str(link)), u, b))
+
+    # Busiest links first, so the interesting rows are on top of large topologies
+    order = sorted(names, key=lambda i: -sum(row[i] for row in util))
+    extent = [bins[0], bins[-1] + width, len(order), 0]
+
+    plt.subplot(211)
+    plt.imshow([[row[i] for row in util] for i in order], aspect='auto', extent=extent, vmin=0, vmax=1,
+               interpolation='nearest')
+    plt.colorbar(label='Utilization')
+    plt.ylabel('Link')
+    if len(order) <= 40:
+        plt.yticks([k + 0.5 for k in range(len(order))], [names[i] for i in order], fontsize='small')
+
+    plt.subplot(212)
+    plt.imshow([[row[i] for row in backlog] for i in order], aspect='auto', extent=extent, interpolation='nearest')
+    plt.colorbar(label='Backlog (packets)')
+    plt.ylabel('Link')
+    plt.xlabel('Time')
+    if len(order) <= 40:
+        plt.yticks([k + 0.5 for k in range(len(order))], [names[i] for i in order], fontsize='small')
+    plt.show()
+
+
+if __name__ == "__main__":
+    main()
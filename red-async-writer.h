@@ -0,0 +1,246 @@
+/** Background I/O thread for the RED scenario traces
+ *
+ * The simulator thread only copies a small fixed-size record into a
+ * lock-free single-producer/single-consumer ring. A dedicated thread pops
+ * the records and does the formatting and the file writes through the
+ * TraceFileWriter each record names, so Simulator::Run () never waits on
+ * the disk.
+ *
+ * The ring has a fixed capacity, so memory stays bounded. When it is full
+ * the producer either waits for the I/O thread (BLOCK, lossless) or counts
+ * the record as lost and moves on (DROP). Stop () drains every queued
+ * record, joins the thread and must be called before Simulator::Destroy ().
+ *
+ * If Start () was never called the writer forwards records synchronously.
+ */
+
+#ifndef RED_ASYNC_WRITER_H
+#define RED_ASYNC_WRITER_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "red-trace-writer.h"
+
+namespace ns3 {
+
+template <typename T>
+class SpscRing
+{
+public:
+    // capacity is rounded up to a power of two
+    explicit SpscRing (size_t capacity)
+      : m_head (0),
+        m_tail (0)
+    {
+        size_t size = 2;
+        while (size < capacity)
+            size <<= 1;
+        m_slots.resize (size);
+        m_mask = size - 1;
+    }
+
+    // producer side
+    bool TryPush (const T &value)
+    {
+        size_t tail = m_tail.load (std::memory_order_relaxed);
+        if (tail - m_head.load (std::memory_order_acquire) > m_mask)
+            return false;
+        m_slots[tail & m_mask] = value;
+        m_tail.store (tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // consumer side; pops up to max records into out and returns the count
+    size_t PopBatch (T *out, size_t max)
+    {
+        size_t head = m_head.load (std::memory_order_relaxed);
+        size_t available = m_tail.load (std::memory_order_acquire) - head;
+        size_t n = available < max ? available : max;
+        for (size_t i = 0; i < n; ++i)
+            out[i] = m_slots[(head + i) & m_mask];
+        m_head.store (head + n, std::memory_order_release);
+        return n;
+    }
+
+    size_t GetCapacity () const
+    {
+        return m_mask + 1;
+    }
+
+private:
+    std::vector<T> m_slots;
+    size_t m_mask;
+    alignas (64) std::atomic<size_t> m_head;
+    alignas (64) std::atomic<size_t> m_tail;
+};
+
+class AsyncTraceWriter
+{
+public:
+    enum Backpressure
+    {
+        BLOCK,
+        DROP
+    };
+
+    struct Record
+    {
+        TraceFileWriter *file;
+        double time;
+        double value;
+        uint32_t seq;
+        uint16_t port;
+        uint16_t queue;
+    };
+
+    explicit AsyncTraceWriter (size_t capacity = 1 << 16, Backpressure policy = BLOCK)
+      : m_ring (capacity),
+        m_policy (policy),
+        m_running (false),
+        m_stop (false),
+        m_lost (0),
+        m_stalls (0)
+    {
+    }
+
+    ~AsyncTraceWriter ()
+    {
+        Stop ();
+    }
+
+    AsyncTraceWriter (const AsyncTraceWriter &) = delete;
+    AsyncTraceWriter &operator= (const AsyncTraceWriter &) = delete;
+
+    // false for anything but block and drop
+    static bool ParseBackpressure (const std::string &name, Backpressure &policy)
+    {
+        if (name == "block")
+            policy = BLOCK;
+        else if (name == "drop")
+            policy = DROP;
+        else
+            return false;
+        return true;
+    }
+
+    void SetBackpressure (Backpressure policy)
+    {
+        m_policy = policy;
+    }
+
+    void Start ()
+    {
+        if (m_running)
+            return;
+        m_stop.store (false, std::memory_order_relaxed);
+        m_running = true;
+        m_thread = std::thread (&AsyncTraceWriter::Consume, this);
+    }
+
+    // Writes everything still queued and joins the I/O thread
+    void Stop ()
+    {
+        if (!m_running)
+            return;
+        m_stop.store (true, std::memory_order_release);
+        m_thread.join ();
+        m_running = false;
+    }
+
+    bool IsRunning () const
+    {
+        return m_running;
+    }
+
+    void WritePacket (TraceFileWriter &file, double time, uint32_t seq, uint16_t port, uint16_t queue)
+    {
+        if (!m_running)
+        {
+            file.WritePacket (time, seq, port, queue);
+            return;
+        }
+        Record r = {&file, time, 0.0, seq, port, queue};
+        Push (r);
+    }
+
+    void WriteSample (TraceFileWriter &file, double time, double value)
+    {
+        if (!m_running)
+        {
+            file.WriteSample (time, value);
+            return;
+        }
+        Record r = {&file, time, value, 0, 0, 0};
+        Push (r);
+    }
+
+    // Records discarded under the DROP policy
+    uint64_t GetLost () const
+    {
+        return m_lost;
+    }
+
+    // Times the producer found the ring full
+    uint64_t GetStalls () const
+    {
+        return m_stalls;
+    }
+
+private:
+    void Push (const Record &r)
+    {
+        if (m_ring.TryPush (r))
+            return;
+        m_stalls++;
+        if (m_policy == DROP)
+        {
+            m_lost++;
+            return;
+        }
+        while (!m_ring.TryPush (r))
+            std::this_thread::yield ();
+    }
+
+    void Consume ()
+    {
+        const size_t batchSize = 1024;
+        std::vector<Record> batch (batchSize);
+        for (;;)
+        {
+            // read the flag first so a Stop () racing with the last push still drains it
+            bool stopping = m_stop.load (std::memory_order_acquire);
+            size_t n = m_ring.PopBatch (batch.data (), batchSize);
+            for (size_t i = 0; i < n; ++i)
+            {
+                const Record &r = batch[i];
+                if (r.file->GetKind () == TraceFileWriter::PACKET)
+                    r.file->WritePacket (r.time, r.seq, r.port, r.queue);
+                else
+                    r.file->WriteSample (r.time, r.value);
+            }
+            if (n == 0)
+            {
+                if (stopping)
+                    return;
+                std::this_thread::sleep_for (std::chrono::microseconds (200));
+            }
+        }
+    }
+
+    SpscRing<Record> m_ring;
+    Backpressure m_policy;
+    bool m_running;
+    std::atomic<bool> m_stop;
+    uint64_t m_lost;
+    uint64_t m_stalls;
+    std::thread m_thread;
+};
+
+} // namespace ns3
+
+#endif /* RED_ASYNC_WRITER_H */
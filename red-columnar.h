@@ -0,0 +1,325 @@
+/** Columnar, compressed trace files (.rcol)
+ *
+ * Text .plot traces of a long run take gigabytes and minutes to parse.
+ * The columnar layout stores each series as blocks of up to 65536 rows and
+ * every column of a block as one contiguous byte run:
+ *
+ *   file   := FileHeader ColumnInfo[columnCount] block*
+ *   block  := uint32 rows, BlockColumn[columnCount], column bytes...
+ *
+ * Column encodings, chosen per block:
+ *  - TIME_NS:   timestamps as integer nanoseconds, delta to the previous
+ *               row, zigzag, LEB128 varint (1-3 bytes per row typically)
+ *  - INT:       integral values (sequence numbers, ports, queue sizes),
+ *               delta, zigzag, varint
+ *  - FLOAT_XOR: IEEE bits XOR the previous row's bits, varint; slowly
+ *               moving averages keep their high bits and shrink
+ * Deltas restart at every block, so blocks decode independently. Fixed
+ * fields are in native byte order, little-endian on every machine we run
+ * on, which is what redcol.py assumes.
+ *
+ * Everything decodes with vectorised prefix sums, so redcol.py loads a
+ * memory-mapped file straight into NumPy arrays; ColumnarReader is the C++
+ * counterpart used by TraceFileWriter::ExportText ().
+ */
+
+#ifndef RED_COLUMNAR_H
+#define RED_COLUMNAR_H
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace ns3 {
+
+class Columnar
+{
+public:
+    enum Encoding
+    {
+        TIME_NS = 1,
+        INT = 2,
+        FLOAT_XOR = 3
+    };
+
+    struct FileHeader
+    {
+        char magic[4];
+        uint16_t version;
+        uint16_t kind;
+        uint32_t textColumns;
+        uint32_t columnCount;
+    };
+
+    struct ColumnInfo
+    {
+        char name[12];
+        uint32_t reserved;
+    };
+
+    struct BlockColumn
+    {
+        uint32_t encoding;
+        uint32_t bytes;
+    };
+
+    static const uint32_t kBlockRows = 65536;
+
+    static void PutVarint (std::vector<uint8_t> &out, uint64_t v)
+    {
+        while (v >= 0x80)
+        {
+            out.push_back (static_cast<uint8_t> (v | 0x80));
+            v >>= 7;
+        }
+        out.push_back (static_cast<uint8_t> (v));
+    }
+
+    static bool GetVarint (const uint8_t *&p, const uint8_t *end, uint64_t &v)
+    {
+        v = 0;
+        for (int shift = 0; p < end && shift < 64; shift += 7)
+        {
+            uint8_t b = *p++;
+            v |= static_cast<uint64_t> (b & 0x7f) << shift;
+            if (!(b & 0x80))
+                return true;
+        }
+        return false;
+    }
+
+    static uint64_t ZigZag (int64_t v)
+    {
+        return (static_cast<uint64_t> (v) << 1) ^ static_cast<uint64_t> (v >> 63);
+    }
+
+    static int64_t UnZigZag (uint64_t v)
+    {
+        return static_cast<int64_t> (v >> 1) ^ -static_cast<int64_t> (v & 1);
+    }
+
+    static uint64_t Bits (double v)
+    {
+        uint64_t bits;
+        std::memcpy (&bits, &v, sizeof (bits));
+        return bits;
+    }
+
+    static double FromBits (uint64_t bits)
+    {
+        double v;
+        std::memcpy (&v, &bits, sizeof (v));
+        return v;
+    }
+
+    // Appends values as one encoded column; the first column of a file is time
+    static uint32_t EncodeColumn (const std::vector<double> &values, bool isTime, std::vector<uint8_t> &out)
+    {
+        uint32_t encoding = isTime ? TIME_NS : INT;
+        if (!isTime)
+        {
+            for (size_t i = 0; i < values.size (); ++i)
+            {
+                double v = values[i];
+                if (v != std::floor (v) || std::fabs (v) > 9007199254740992.0)
+                {
+                    encoding = FLOAT_XOR;
+                    break;
+                }
+            }
+        }
+
+        int64_t prev = 0;
+        uint64_t prevBits = 0;
+        for (size_t i = 0; i < values.size (); ++i)
+        {
+            if (encoding == FLOAT_XOR)
+            {
+                uint64_t bits = Bits (values[i]);
+                PutVarint (out, bits ^ prevBits);
+                prevBits = bits;
+                continue;
+            }
+            int64_t v = encoding == TIME_NS ? std::llround (values[i] * 1e9) : static_cast<int64_t> (values[i]);
+            PutVarint (out, ZigZag (v - prev));
+            prev = v;
+        }
+        return encoding;
+    }
+
+    static bool DecodeColumn (uint32_t encoding, const uint8_t *p, const uint8_t *end, uint32_t rows,
+                              std::vector<double> &out)
+    {
+        int64_t prev = 0;
+        uint64_t prevBits = 0;
+        for (uint32_t i = 0; i < rows; ++i)
+        {
+            uint64_t v;
+            if (!GetVarint (p, end, v))
+                return false;
+            if (encoding == FLOAT_XOR)
+            {
+                prevBits ^= v;
+                out.push_back (FromBits (prevBits));
+                continue;
+            }
+            prev += UnZigZag (v);
+            out.push_back (encoding == TIME_NS ? prev / 1e9 : static_cast<double> (prev));
+        }
+        return p == end;
+    }
+};
+
+// Collects rows and turns every kBlockRows of them into one encoded block
+class ColumnarBlockWriter
+{
+public:
+    void Reset (uint32_t columns)
+    {
+        m_values.assign (columns, std::vector<double> ());
+        m_rows = 0;
+    }
+
+    // Returns true when the block is full and should be encoded
+    bool Add (const double *row)
+    {
+        for (size_t c = 0; c < m_values.size (); ++c)
+            m_values[c].push_back (row[c]);
+        return ++m_rows >= Columnar::kBlockRows;
+    }
+
+    uint32_t GetRows () const
+    {
+        return m_rows;
+    }
+
+    void Encode (std::vector<uint8_t> &out)
+    {
+        std::vector<Columnar::BlockColumn> info (m_values.size ());
+        std::vector<std::vector<uint8_t> > data (m_values.size ());
+        for (size_t c = 0; c < m_values.size (); ++c)
+        {
+            info[c].encoding = Columnar::EncodeColumn (m_values[c], c == 0, data[c]);
+            info[c].bytes = data[c].size ();
+        }
+
+        const uint8_t *rows = reinterpret_cast<const uint8_t *> (&m_rows);
+        out.insert (out.end (), rows, rows + sizeof (m_rows));
+        const uint8_t *head = reinterpret_cast<const uint8_t *> (info.data ());
+        out.insert (out.end (), head, head + info.size () * sizeof (Columnar::BlockColumn));
+        for (size_t c = 0; c < data.size (); ++c)
+        {
+            out.insert (out.end (), data[c].begin (), data[c].end ());
+            m_values[c].clear ();
+        }
+        m_rows = 0;
+    }
+
+private:
+    std::vector<std::vector<double> > m_values;
+    uint32_t m_rows = 0;
+};
+
+class ColumnarReader
+{
+public:
+    // Reads and decodes a whole file; returns false on a malformed one
+    bool Load (const std::string &path)
+    {
+        FILE *in = std::fopen (path.c_str (), "rb");
+        if (!in)
+            return false;
+        std::vector<uint8_t> bytes;
+        uint8_t chunk[1 << 16];
+        size_t n;
+        while ((n = std::fread (chunk, 1, sizeof (chunk), in)) > 0)
+            bytes.insert (bytes.end (), chunk, chunk + n);
+        std::fclose (in);
+
+        const uint8_t *p = bytes.data ();
+        const uint8_t *end = p + bytes.size ();
+        if (bytes.size () < sizeof (m_header))
+            return false;
+        std::memcpy (&m_header, p, sizeof (m_header));
+        p += sizeof (m_header);
+        if (std::memcmp (m_header.magic, "RCOL", 4) != 0)
+            return false;
+
+        uint32_t columns = m_header.columnCount;
+        if (static_cast<size_t> (end - p) < columns * sizeof (Columnar::ColumnInfo))
+            return false;
+        m_names.clear ();
+        for (uint32_t c = 0; c < columns; ++c)
+        {
+            Columnar::ColumnInfo info;
+            std::memcpy (&info, p, sizeof (info));
+            p += sizeof (info);
+            m_names.push_back (std::string (info.name, strnlen (info.name, sizeof (info.name))));
+        }
+
+        m_columns.assign (columns, std::vector<double> ());
+        std::vector<Columnar::BlockColumn> block (columns);
+        while (p < end)
+        {
+            uint32_t rows;
+            size_t head = sizeof (rows) + columns * sizeof (Columnar::BlockColumn);
+            if (static_cast<size_t> (end - p) < head)
+                return false;
+            std::memcpy (&rows, p, sizeof (rows));
+            std::memcpy (block.data (), p + sizeof (rows), columns * sizeof (Columnar::BlockColumn));
+            p += head;
+            for (uint32_t c = 0; c < columns; ++c)
+            {
+                if (static_cast<size_t> (end - p) < block[c].bytes
+                    || !Columnar::DecodeColumn (block[c].encoding, p, p + block[c].bytes, rows, m_columns[c]))
+                    return false;
+                p += block[c].bytes;
+            }
+        }
+        return true;
+    }
+
+    uint16_t GetKind () const
+    {
+        return m_header.kind;
+    }
+
+    uint32_t GetTextColumns () const
+    {
+        return m_header.textColumns;
+    }
+
+    const std::vector<std::string> &GetNames () const
+    {
+        return m_names;
+    }
+
+    // The named column, or an empty vector when the file has none
+    const std::vector<double> &Get (const std::string &name) const
+    {
+        static const std::vector<double> none;
+        for (size_t c = 0; c < m_names.size (); ++c)
+        {
+            if (m_names[c] == name)
+                return m_columns[c];
+        }
+        return none;
+    }
+
+    size_t GetRows () const
+    {
+        return m_columns.empty () ? 0 : m_columns[0].size ();
+    }
+
+private:
+    Columnar::FileHeader m_header;
+    std::vector<std::string> m_names;
+    std::vector<std::vector<double> > m_columns;
+};
+
+} // namespace ns3
+
+#endif /* RED_COLUMNAR_H */
@@ -0,0 +1,229 @@
+/** Pieces shared by every RED scenario
+ *
+ * The TCP and RED attribute defaults and the end-of-run sink report used
+ * to be copied into each program. They live here so p2a/p2b/p2c and the
+ * config-driven red-scenario engine set up the same experiment.
+ *
+ * The bottleneck disc is chosen with --aqm (see SetRootAqm): red, ared
+ * (Adaptive RED), pie, codel, fqcodel or pfifo, all held to the same
+ * --maxPackets limit so their queueing delay and throughput compare
+ * directly. --byteMode is RED's alone and is refused with the others.
+ * With --ecn RED marks ECN-capable packets instead of dropping them and
+ * TCP negotiates ECN (see ApplyRedDefaults). With --byteMode RED counts
+ * bytes: the thresholds and the limit, still given in packets, are scaled
+ * by --meanPktSize, and RED scales each packet's drop probability by its
+ * size over meanPktSize, so a 64-byte ACK is far less likely to be dropped
+ * than a 1500-byte segment. Queue lengths in the traces and the summary
+ * are then bytes too.
+ */
+
+#ifndef RED_COMMON_H
+#define RED_COMMON_H
+
+#include <cstdio>
+#include <iostream>
+#include <string>
+
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include "ns3/core-module.h"
+#include "ns3/applications-module.h"
+#include "ns3/traffic-control-module.h"
+
+namespace ns3 {
+
+struct RedParams
+{
+    uint32_t meanPktSize = 500;
+    double qw = 0.002;
+    double minTh = 5;
+    double maxTh = 15;
+    uint32_t queueLimit = 40;
+    std::string linkRate = "45Mbps";
+    std::string linkDelay = "2ms";
+    bool wait = true;
+    bool gentle = true;
+    std::string aqm = "red";
+    bool ecn = false;
+    bool byteMode = false;
+
+    // Registers the values a sweep may want to change
+    void AddValues (CommandLine &cmd)
+    {
+        cmd.AddValue ("minTh", "RED minimum threshold (packets)", minTh);
+        cmd.AddValue ("maxTh", "RED maximum threshold (packets)", maxTh);
+        cmd.AddValue ("qw", "RED queue weight for the average queue size", qw);
+        cmd.AddValue ("aqm", "<red/ared/pie/codel/fqcodel/pfifo> queue disc on the bottleneck", aqm);
+        cmd.AddValue ("ecn", "<0/1> RED marks ECN-capable packets instead of dropping them, TCP negotiates ECN", ecn);
+        cmd.AddValue ("byteMode", "<0/1> RED counts bytes, thresholds and limit are scaled by --meanPktSize", byteMode);
+        cmd.AddValue ("meanPktSize", "RED's mean packet size (bytes), the unit of --byteMode", meanPktSize);
+    }
+
+    // What one packet of minTh, maxTh and queueLimit counts as in RED's
+    // queue length: a packet, or meanPktSize bytes in byte mode
+    double GetQueueUnit () const
+    {
+        return byteMode ? meanPktSize : 1;
+    }
+};
+
+inline void
+ApplyTcpDefaults (uint32_t segmentSize)
+{
+    Config::SetDefault ("ns3::TcpL4Protocol::SocketType", StringValue ("ns3::TcpNewReno"));
+    Config::SetDefault ("ns3::TcpSocket::SegmentSize", UintegerValue (segmentSize));
+    Config::SetDefault ("ns3::TcpSocket::DelAckCount", UintegerValue (1));
+}
+
+// Makes TCP sockets negotiate ECN. The ns-3 releases that still have
+// RedQueueDisc's Mode call it EcnMode=ClassicEcn; UseEcn, an Off/On/
+// AcceptOnly enum, replaced it later. Returns false when TcpSocketBase has
+// neither and segments stay Not-ECT.
+inline bool
+EnableTcpEcn ()
+{
+    return Config::SetDefaultFailSafe ("ns3::TcpSocketBase::EcnMode", StringValue ("ClassicEcn"))
+           || Config::SetDefaultFailSafe ("ns3::TcpSocketBase::UseEcn", StringValue ("On"));
+}
+
+inline void
+ApplyRedDefaults (const RedParams &red)
+{
+    double unit = red.GetQueueUnit ();
+    Config::SetDefault ("ns3::RedQueueDisc::Mode",
+                        StringValue (red.byteMode ? "QUEUE_DISC_MODE_BYTES" : "QUEUE_DISC_MODE_PACKETS"));
+    Config::SetDefault ("ns3::RedQueueDisc::MeanPktSize", UintegerValue (red.meanPktSize));
+    Config::SetDefault ("ns3::RedQueueDisc::Wait", BooleanValue (red.wait));
+    Config::SetDefault ("ns3::RedQueueDisc::Gentle", BooleanValue (red.gentle));
+    Config::SetDefault ("ns3::RedQueueDisc::QW", DoubleValue (red.qw));
+    Config::SetDefault ("ns3::RedQueueDisc::MinTh", DoubleValue (red.minTh * unit));
+    Config::SetDefault ("ns3::RedQueueDisc::MaxTh", DoubleValue (red.maxTh * unit));
+    Config::SetDefault ("ns3::RedQueueDisc::LinkBandwidth", StringValue (red.linkRate));
+    Config::SetDefault ("ns3::RedQueueDisc::LinkDelay", StringValue (red.linkDelay));
+    Config::SetDefault ("ns3::RedQueueDisc::QueueLimit", UintegerValue (static_cast<uint32_t> (red.queueLimit * unit)));
+    if (red.ecn)
+    {
+        Config::SetDefault ("ns3::RedQueueDisc::UseEcn", BooleanValue (true));
+        NS_ABORT_MSG_IF (!EnableTcpEcn (), "--ecn: this ns-3's TCP cannot negotiate ECN, RED would drop what it marks");
+    }
+}
+
+inline bool
+IsKnownAqm (const std::string &aqm)
+{
+    return aqm == "red" || aqm == "ared" || aqm == "pie" || aqm == "codel" || aqm == "fqcodel" || aqm == "pfifo";
+}
+
+// Makes tch install the named AQM as root disc, limited to red.queueLimit
+// packets (bytes of meanPktSize under --byteMode, which only RED and
+// Adaptive RED have). RED's other parameters are the defaults from
+// ApplyRedDefaults; linkRate and linkDelay are what ARED derives its
+// parameters from.
+inline void
+SetRootAqm (TrafficControlHelper &tch, const std::string &aqm, const RedParams &red,
+            const std::string &linkRate, const std::string &linkDelay)
+{
+    bool isRed = aqm == "red" || aqm == "ared";
+    NS_ABORT_MSG_IF (red.byteMode && !isRed, "--byteMode is RED's, " << aqm << " counts packets");
+    uint32_t limit = red.queueLimit;
+    if (isRed)
+        tch.SetRootQueueDisc ("ns3::RedQueueDisc",
+                              "ARED", BooleanValue (aqm == "ared"),
+                              "Mode", StringValue (red.byteMode ? "QUEUE_DISC_MODE_BYTES" : "QUEUE_DISC_MODE_PACKETS"),
+                              "QueueLimit", UintegerValue (static_cast<uint32_t> (limit * red.GetQueueUnit ())),
+                              "LinkBandwidth", StringValue (linkRate),
+                              "LinkDelay", StringValue (linkDelay));
+    else if (aqm == "pie")
+        tch.SetRootQueueDisc ("ns3::PieQueueDisc",
+                              "Mode", StringValue ("QUEUE_DISC_MODE_PACKETS"),
+                              "QueueLimit", UintegerValue (limit));
+    else if (aqm == "codel")
+        tch.SetRootQueueDisc ("ns3::CoDelQueueDisc",
+                              "Mode", StringValue ("QUEUE_DISC_MODE_PACKETS"),
+                              "MaxPackets", UintegerValue (limit));
+    else if (aqm == "fqcodel")
+    {
+        uint16_t handle = tch.SetRootQueueDisc ("ns3::FqCoDelQueueDisc", "PacketLimit", UintegerValue (limit));
+        tch.AddPacketFilter (handle, "ns3::FqCoDelIpv4PacketFilter");
+    }
+    else if (aqm == "pfifo")
+        tch.SetRootQueueDisc ("ns3::PfifoFastQueueDisc", "Limit", UintegerValue (limit));
+    else
+        NS_FATAL_ERROR ("unknown --aqm '" << aqm << "'");
+}
+
+// Starts every application at start plus a Uniform[0, jitter) offset drawn
+// from the run's random stream, so replications with different
+// --runNumber values are not copies of each other
+inline void
+StartWithJitter (ApplicationContainer apps, double start, double jitter)
+{
+    Ptr<UniformRandomVariable> offset = CreateObject<UniformRandomVariable> ();
+    for (uint32_t i = 0; i < apps.GetN (); ++i)
+        apps.Get (i)->SetStartTime (Seconds (start + (jitter > 0 ? offset->GetValue (0, jitter) : 0)));
+}
+
+// Bytes received so far by every PacketSink in sinks
+inline uint64_t
+SumSinkBytes (const ApplicationContainer &sinks)
+{
+    uint64_t totalBytes = 0;
+    for (uint32_t i = 0; i < sinks.GetN (); ++i)
+        totalBytes += DynamicCast<PacketSink> (sinks.Get (i))->GetTotalRx ();
+    return totalBytes;
+}
+
+// Prints the bytes received by every PacketSink and returns the total
+inline uint64_t
+ReportSinkTotals (const ApplicationContainer &sinks)
+{
+    uint64_t totalBytes = 0;
+
+    for (uint32_t i = 0; i < sinks.GetN (); ++i)
+    {
+        Ptr<PacketSink> pktSink = DynamicCast<PacketSink> (sinks.Get (i));
+        uint64_t received = pktSink->GetTotalRx ();
+        std::cout << "\tSink\t" << i << "\tBytes\t" << received << std::endl;
+        totalBytes += received;
+    }
+
+    std::cout << std::endl << "\tTotal\t\tBytes\t" << totalBytes << std::endl;
+    return totalBytes;
+}
+
+// Current resident set size in bytes, 0 where /proc is not available
+inline uint64_t
+GetResidentBytes ()
+{
+    FILE *f = std::fopen ("/proc/self/statm", "r");
+    if (!f)
+        return 0;
+    unsigned long size = 0;
+    unsigned long resident = 0;
+    if (std::fscanf (f, "%lu %lu", &size, &resident) != 2)
+        resident = 0;
+    std::fclose (f);
+    return static_cast<uint64_t> (resident) * sysconf (_SC_PAGESIZE);
+}
+
+// Resident bytes gained from before to after, per flow; 0 when there are
+// no flows or the resident size shrank
+inline double
+GetBytesPerFlow (uint64_t before, uint64_t after, uint32_t flows)
+{
+    return flows > 0 && after > before ? double (after - before) / flows : 0.0;
+}
+
+// Peak resident set size of the process so far, in bytes
+inline uint64_t
+GetPeakResidentBytes ()
+{
+    struct rusage usage;
+    getrusage (RUSAGE_SELF, &usage);
+    return static_cast<uint64_t> (usage.ru_maxrss) * 1024;
+}
+
+} // namespace ns3
+
+#endif /* RED_COMMON_H */
@@ -0,0 +1,359 @@
+/** Flow lifecycle and completion times
+ *
+ * The sinks' byte totals cannot tell a 10 KB RPC from a bulk transfer. An
+ * FctTracker follows every finite flow of the workloads (red-workload.h)
+ * from its start (the SYN) through its first and last byte at the sink: a
+ * source calls Begin () once connected, with the flow's local address and
+ * port and its size, and the PacketSinks' Rx trace does the rest. Only
+ * running flows are kept; a completed flow goes into per-size-bucket
+ * histograms (DelayHistogram, red-sojourn.h) and is forgotten, so memory
+ * stays bounded however many flows a run completes.
+ *
+ * Each flow's slowdown is its completion time over the ideal one,
+ * --fctBaseDelay plus its bytes at --fctLineRate (by default the
+ * bottleneck's rate). With the default base delay of 0 the slowdown of a
+ * short flow is dominated by its round trips; set the base delay to the
+ * completion time of a one-byte flow in the empty network to compare
+ * sizes fairly.
+ *
+ * --fctBuckets="10000,100000,1000000" sets the upper size bounds (bytes)
+ * of the buckets, one more takes the larger flows. With --writeFct,
+ * <pathOut>/fct.txt gets:
+ *   W <window>
+ *   T <windowStart> <bucket> <flows> <fctP50> <fctP99> <slowdownP50> <slowdownP99>
+ *                                  per --fctWindow, for the flows completed in it
+ *   B <bucket> <flows> <fctP50> <fctP90> <fctP99> <fctP99.9> <fctMax> <slowdownP50> <slowdownP99>
+ *                                  per bucket over the run
+ *   F <start> <firstByte> <lastByte> <bytes> <slowdown>
+ *                                  per completed flow, with --fctPerFlow
+ *   I <start> <firstByte> <bytes> <received>
+ *                                  per flow still running at the end
+ * Times are seconds, <bucket> is "<upTo>" or "Over<last bound>", a
+ * firstByte of -1 means none arrived yet. plotfct.py draws the CDFs.
+ */
+
+#ifndef RED_FCT_H
+#define RED_FCT_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/internet-module.h"
+
+#include "red-profile.h"
+#include "red-run-summary.h"
+#include "red-sojourn.h"
+
+namespace ns3 {
+
+class FctTracker
+{
+public:
+    FctTracker ()
+      : m_writeFct (false),
+        m_perFlow (false),
+        m_window (0.1),
+        m_bucketList ("10000,100000,1000000"),
+        m_shortBytes (100000),
+        m_baseDelay (0),
+        m_bps (0),
+        m_file (nullptr),
+        m_windowStart (0),
+        m_started (0)
+    {
+    }
+
+    ~FctTracker ()
+    {
+        if (m_file)
+            std::fclose (m_file);
+    }
+
+    void AddValues (CommandLine &cmd)
+    {
+        cmd.AddValue ("writeFct", "<0/1> write flow completion time percentiles per size bucket to <pathOut>/fct.txt", m_writeFct);
+        cmd.AddValue ("fctPerFlow", "<0/1> also write a --writeFct line per completed flow", m_perFlow);
+        cmd.AddValue ("fctWindow", "Window of the per-window --writeFct percentiles (seconds)", m_window);
+        cmd.AddValue ("fctBuckets", "Upper bounds (bytes) of the flow size buckets", m_bucketList);
+        cmd.AddValue ("shortFlowBytes", "Largest flow counted in the short-flow completion times (bytes)", m_shortBytes);
+        cmd.AddValue ("fctLineRate", "Rate of the ideal completion time behind the slowdown (default: the bottleneck's)", m_lineRate);
+        cmd.AddValue ("fctBaseDelay", "Fixed part of the ideal completion time (seconds)", m_baseDelay);
+    }
+
+    bool IsWriting () const
+    {
+        return m_writeFct;
+    }
+
+    // Parses --fctBuckets; call after cmd.Parse ()
+    bool Configure (std::string &error)
+    {
+        m_bounds.clear ();
+        std::istringstream in (m_bucketList);
+        std::string part;
+        while (std::getline (in, part, ','))
+            if (!part.empty ())
+                m_bounds.push_back (std::strtoull (part.c_str (), nullptr, 10));
+        std::sort (m_bounds.begin (), m_bounds.end ());
+        m_bounds.erase (std::unique (m_bounds.begin (), m_bounds.end ()), m_bounds.end ());
+        m_buckets.assign (m_bounds.size () + 1, Bucket ());
+        if (m_window <= 0)
+        {
+            error = "--fctWindow must be positive";
+            return false;
+        }
+        if (!m_lineRate.empty ())
+            m_bps = DataRate (m_lineRate).GetBitRate ();
+        return true;
+    }
+
+    // Rate of the ideal completion time, normally the bottleneck's; ignored
+    // when --fctLineRate is given
+    void SetLineRate (const std::string &rate)
+    {
+        if (m_lineRate.empty ())
+            m_bps = DataRate (rate).GetBitRate ();
+    }
+
+    bool Open (const std::string &path)
+    {
+        m_file = std::fopen (path.c_str (), "w");
+        if (!m_file)
+            return false;
+        std::fprintf (m_file, "W %g\n", m_window);
+        m_windowStart = Simulator::Now ().GetSeconds ();
+        return true;
+    }
+
+    // Follows the flows into the PacketSinks in sinks
+    void Watch (const ApplicationContainer &sinks)
+    {
+        for (uint32_t i = 0; i < sinks.GetN (); ++i)
+            sinks.Get (i)->TraceConnectWithoutContext ("Rx", MakeBoundCallback (&FctTracker::Received, this));
+    }
+
+    // A flow of bytes, started at start, now sends from local
+    void Begin (const Address &local, uint64_t bytes, double start)
+    {
+        Flow &flow = m_active[KeyOf (local)];
+        flow.bytes = bytes;
+        flow.received = 0;
+        flow.start = start;
+        flow.firstByte = -1;
+        m_started++;
+    }
+
+    // Forgets the completions so far, e.g. after a warm-up; running flows
+    // still complete
+    void Restart ()
+    {
+        double now = Simulator::Now ().GetSeconds ();
+        if (m_file)
+            CloseWindows (now);
+        m_started = m_active.size ();
+        for (Bucket &b : m_buckets)
+            b = Bucket ();
+        m_ttfb.Reset ();
+        m_short.Reset ();
+        m_windowStart = now;
+    }
+
+    // Writes the last window, the buckets and the flows still running, and
+    // closes fct.txt
+    void Finish (double stopTime)
+    {
+        if (!m_file)
+            return;
+        CloseWindows (stopTime);
+        for (size_t k = 0; k < m_buckets.size (); ++k)
+        {
+            const Bucket &b = m_buckets[k];
+            std::fprintf (m_file, "B %s %llu %.6f %.6f %.6f %.6f %.6f %.4f %.4f\n", GetBucketName (k).c_str (),
+                          (unsigned long long) b.fct.GetCount (), b.fct.Quantile (0.5), b.fct.Quantile (0.9),
+                          b.fct.Quantile (0.99), b.fct.Quantile (0.999), b.fct.GetMax (), b.slowdown.Quantile (0.5),
+                          b.slowdown.Quantile (0.99));
+        }
+        for (const std::pair<const Key, Flow> &entry : m_active)
+        {
+            const Flow &flow = entry.second;
+            std::fprintf (m_file, "I %.9f %.9f %llu %llu\n", flow.start, flow.firstByte,
+                          (unsigned long long) flow.bytes, (unsigned long long) flow.received);
+        }
+        std::fclose (m_file);
+        m_file = nullptr;
+    }
+
+    // fctStarted, fctCompleted, fctRunning, the completion time and time to
+    // first byte quantiles over all flows and the short ones, and per
+    // bucket fct<bucket>Flows, P50Ms, P99Ms, SlowdownP50 and SlowdownP99
+    void Report (RunSummary &summary) const
+    {
+        DelayHistogram all;
+        uint64_t completed = 0;
+        for (const Bucket &b : m_buckets)
+        {
+            all.Merge (b.fct);
+            completed += b.fct.GetCount ();
+        }
+        summary.Add ("fctStarted", m_started);
+        summary.Add ("fctCompleted", completed);
+        summary.Add ("fctRunning", m_active.size ());
+        summary.Add ("fctP50Ms", all.Quantile (0.5) * 1e3);
+        summary.Add ("fctP99Ms", all.Quantile (0.99) * 1e3);
+        summary.Add ("ttfbP50Ms", m_ttfb.Quantile (0.5) * 1e3);
+        summary.Add ("ttfbP99Ms", m_ttfb.Quantile (0.99) * 1e3);
+        summary.Add ("fctShortBytes", m_shortBytes);
+        summary.Add ("fctShortCompleted", m_short.GetCount ());
+        summary.Add ("fctShortP50Ms", m_short.Quantile (0.5) * 1e3);
+        summary.Add ("fctShortP99Ms", m_short.Quantile (0.99) * 1e3);
+        for (size_t k = 0; k < m_buckets.size (); ++k)
+        {
+            const Bucket &b = m_buckets[k];
+            std::string prefix = "fct" + GetBucketName (k);
+            summary.Add (prefix + "Flows", b.fct.GetCount ());
+            summary.Add (prefix + "P50Ms", b.fct.Quantile (0.5) * 1e3);
+            summary.Add (prefix + "P99Ms", b.fct.Quantile (0.99) * 1e3);
+            summary.Add (prefix + "SlowdownP50", b.slowdown.Quantile (0.5));
+            summary.Add (prefix + "SlowdownP99", b.slowdown.Quantile (0.99));
+        }
+    }
+
+    // "<upTo>", or "Over<last bound>" for the largest flows
+    std::string GetBucketName (size_t k) const
+    {
+        if (k < m_bounds.size ())
+            return std::to_string (m_bounds[k]);
+        return m_bounds.empty () ? "All" : "Over" + std::to_string (m_bounds.back ());
+    }
+
+private:
+    typedef std::pair<uint32_t, uint16_t> Key;
+
+    struct Flow
+    {
+        uint64_t bytes;
+        uint64_t received;
+        double start;
+        double firstByte;
+    };
+
+    // Completion times in ns; slowdowns are stored times 1e9, so the
+    // histogram's "seconds" are the slowdown itself
+    struct Bucket
+    {
+        DelayHistogram fct;
+        DelayHistogram slowdown;
+        DelayHistogram windowFct;
+        DelayHistogram windowSlowdown;
+    };
+
+    static CallbackTimer &Timer ()
+    {
+        static CallbackTimer timer ("Fct");
+        return timer;
+    }
+
+    static Key KeyOf (const Address &address)
+    {
+        InetSocketAddress inet = InetSocketAddress::ConvertFrom (address);
+        return Key (inet.GetIpv4 ().Get (), inet.GetPort ());
+    }
+
+    static void Received (FctTracker *tracker, Ptr<const Packet> packet, const Address &from)
+    {
+        TimedScope timed (Timer ());
+        if (tracker->m_active.empty () || !InetSocketAddress::IsMatchingType (from))
+            return;
+        std::map<Key, Flow>::iterator it = tracker->m_active.find (KeyOf (from));
+        if (it == tracker->m_active.end ())
+            return;
+        Flow &flow = it->second;
+        double now = Simulator::Now ().GetSeconds ();
+        if (flow.received == 0)
+        {
+            flow.firstByte = now;
+            tracker->m_ttfb.Record (static_cast<uint64_t> ((now - flow.start) * 1e9));
+        }
+        flow.received += packet->GetSize ();
+        if (flow.received < flow.bytes)
+            return;
+        tracker->Complete (flow, now);
+        tracker->m_active.erase (it);
+    }
+
+    void Complete (const Flow &flow, double now)
+    {
+        if (m_file && now >= m_windowStart + m_window)
+            CloseWindows (now);
+
+        double fct = now - flow.start;
+        double ideal = m_baseDelay + (m_bps > 0 ? flow.bytes * 8.0 / m_bps : 0);
+        double slowdown = ideal > 0 ? fct / ideal : 0;
+        uint64_t ns = static_cast<uint64_t> (fct * 1e9);
+        uint64_t scaled = static_cast<uint64_t> (slowdown * 1e9);
+        size_t k = std::lower_bound (m_bounds.begin (), m_bounds.end (), flow.bytes) - m_bounds.begin ();
+        Bucket &b = m_buckets[k];
+        b.fct.Record (ns);
+        b.slowdown.Record (scaled);
+        if (m_file)
+        {
+            b.windowFct.Record (ns);
+            b.windowSlowdown.Record (scaled);
+        }
+        if (flow.bytes <= m_shortBytes)
+            m_short.Record (ns);
+        if (m_file && m_perFlow)
+            std::fprintf (m_file, "F %.9f %.9f %.9f %llu %.4f\n", flow.start, flow.firstByte, now,
+                          (unsigned long long) flow.bytes, slowdown);
+    }
+
+    // Writes a T line for every bucket that completed flows in the windows
+    // ending before now
+    void CloseWindows (double now)
+    {
+        for (size_t k = 0; k < m_buckets.size (); ++k)
+        {
+            Bucket &b = m_buckets[k];
+            if (b.windowFct.GetCount () == 0)
+                continue;
+            std::fprintf (m_file, "T %g %s %llu %.6f %.6f %.4f %.4f\n", m_windowStart, GetBucketName (k).c_str (),
+                          (unsigned long long) b.windowFct.GetCount (), b.windowFct.Quantile (0.5),
+                          b.windowFct.Quantile (0.99), b.windowSlowdown.Quantile (0.5),
+                          b.windowSlowdown.Quantile (0.99));
+            b.windowFct.Reset ();
+            b.windowSlowdown.Reset ();
+        }
+        m_windowStart += m_window * std::floor ((now - m_windowStart) / m_window);
+    }
+
+    bool m_writeFct;
+    bool m_perFlow;
+    double m_window;
+    std::string m_bucketList;
+    uint64_t m_shortBytes;
+    std::string m_lineRate;
+    double m_baseDelay;
+    double m_bps;
+    FILE *m_file;
+    double m_windowStart;
+    uint64_t m_started;
+    std::vector<uint64_t> m_bounds;
+    std::vector<Bucket> m_buckets;
+    std::map<Key, Flow> m_active;
+    DelayHistogram m_ttfb;
+    DelayHistogram m_short;
+};
+
+} // namespace ns3
+
+#endif /* RED_FCT_H */
@@ -0,0 +1,310 @@
+/** Rolling per-packet traces for long runs
+ *
+ * The PacketNum/PacketDrop traces grow with every packet, which is what
+ * keeps the scenarios at a 1 s stop time. A FlightRecorder keeps the
+ * per-packet records of the monitored queues only in a fixed-size ring,
+ * so memory is the same after a second or after hours of simulated time.
+ * When something interesting happens the last --recordWindow seconds of
+ * the ring are written to <pathOut>/dump-NNN.txt:
+ *
+ *  - drops: --dumpDrops drops within one --triggerWindow
+ *  - queue: a queue grows above --dumpQueue packets (default RED's maxTh;
+ *    packets of meanPktSize bytes with --byteMode)
+ *  - fairness: the Jain index over the bytes the flows enqueued in one
+ *    --triggerWindow falls below --dumpJain. Only the flows of the current
+ *    window are kept, so this too stays bounded however many flows a run
+ *    sees.
+ *
+ * After a dump, triggers are ignored for one record window so dumps do
+ * not overlap, and after --maxDumps only the trigger counts go on; disk
+ * use is bounded by maxDumps times the ring. Everything else is left to
+ * the aggregated statistics in summary.txt.
+ *
+ * A dump file holds
+ *   # <reason> at <time>, last <window> s
+ *   A <time> <queue> <qlen> <seq> <port>      packet arrival, qlen before it
+ *   D <time> <queue> <qlen> <seq> <port>      packet drop
+ * When the ring wrapped within the window the oldest records are missing;
+ * raise --recordCapacity for busy links.
+ */
+
+#ifndef RED_FLIGHT_RECORDER_H
+#define RED_FLIGHT_RECORDER_H
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "ns3/core-module.h"
+#include "ns3/traffic-control-module.h"
+
+#include "red-flow-table.h"
+#include "red-occupancy.h"
+#include "red-profile.h"
+#include "red-run-summary.h"
+#include "red-tcp-peek.h"
+
+namespace ns3 {
+
+class FlightRecorder
+{
+public:
+    FlightRecorder ()
+      : m_window (0),
+        m_capacity (1 << 18),
+        m_dumpDrops (50),
+        m_dumpQueue (-1),
+        m_dumpJain (0.5),
+        m_triggerWindow (0.1),
+        m_maxDumps (20),
+        m_next (0),
+        m_count (0),
+        m_dropHead (0),
+        m_quietUntil (0),
+        m_binStart (0),
+        m_dumps (0),
+        m_dropTriggers (0),
+        m_queueTriggers (0),
+        m_fairnessTriggers (0)
+    {
+    }
+
+    void AddValues (CommandLine &cmd)
+    {
+        cmd.AddValue ("recordWindow", "Keep per-packet records only for the last this many seconds, dumped on triggers (0 = full traces)", m_window);
+        cmd.AddValue ("recordCapacity", "Records the --recordWindow ring holds", m_capacity);
+        cmd.AddValue ("dumpDrops", "Dump when this many drops fall into one --triggerWindow (0 = never)", m_dumpDrops);
+        cmd.AddValue ("dumpQueue", "Dump when a queue grows above this many packets (of --meanPktSize bytes with --byteMode; default maxTh, 0 = never)", m_dumpQueue);
+        cmd.AddValue ("dumpJain", "Dump when the Jain index of one --triggerWindow falls below this (0 = never)", m_dumpJain);
+        cmd.AddValue ("triggerWindow", "Window of the drop and fairness triggers (seconds)", m_triggerWindow);
+        cmd.AddValue ("maxDumps", "Dumps written at most; later triggers are only counted", m_maxDumps);
+    }
+
+    bool IsEnabled () const
+    {
+        return m_window > 0;
+    }
+
+    // Dumps go under pathOut; maxTh is the --dumpQueue default, unit what
+    // one packet counts as in the queue length (see RedParams::GetQueueUnit)
+    void Open (const std::string &pathOut, double maxTh, double unit)
+    {
+        m_pathOut = pathOut;
+        m_dumpQueue = (m_dumpQueue < 0 ? maxTh : m_dumpQueue) * unit;
+        m_ring.resize (m_capacity > 0 ? m_capacity : 1);
+        m_dropTimes.assign (m_dumpDrops, -1.0);
+    }
+
+    void SetPath (const std::string &pathOut)
+    {
+        m_pathOut = pathOut;
+    }
+
+    // Records every packet entering or dropped by queue under id
+    void Connect (Ptr<QueueDisc> queue, uint32_t id)
+    {
+        if (id >= m_queues.size ())
+            m_queues.resize (id + 1);
+        m_queues[id].queue = queue;
+        m_queues[id].bytes = CountsBytes (queue);
+        m_queues[id].above = false;
+        queue->TraceConnectWithoutContext ("Enqueue", MakeBoundCallback (&FlightRecorder::Enqueued, this, id));
+        queue->TraceConnectWithoutContext ("Drop", MakeBoundCallback (&FlightRecorder::Dropped, this, id));
+    }
+
+    void Report (RunSummary &summary) const
+    {
+        summary.Add ("recordWindow", m_window);
+        summary.Add ("dumps", m_dumps);
+        summary.Add ("dropTriggers", m_dropTriggers);
+        summary.Add ("queueTriggers", m_queueTriggers);
+        summary.Add ("fairnessTriggers", m_fairnessTriggers);
+    }
+
+private:
+    enum Kind
+    {
+        ARRIVAL = 0,
+        DROP = 1
+    };
+
+    struct Record
+    {
+        double time;
+        uint32_t seq;
+        uint32_t qlen;
+        uint16_t port;
+        uint16_t queue;
+        uint8_t kind;
+    };
+
+    struct Queue
+    {
+        Ptr<QueueDisc> queue;
+        bool bytes;
+        bool above;
+    };
+
+    static CallbackTimer &Timer ()
+    {
+        static CallbackTimer timer ("Recorder");
+        return timer;
+    }
+
+    static void Enqueued (FlightRecorder *recorder, uint32_t id, Ptr<const QueueDiscItem> item)
+    {
+        TimedScope timed (Timer ());
+        double now = Simulator::Now ().GetSeconds ();
+        Queue &q = recorder->m_queues[id];
+        uint32_t qlen = ArrivalOccupancy (q.queue, q.bytes, item);
+        recorder->Push (now, id, ARRIVAL, qlen, item);
+
+        bool above = recorder->m_dumpQueue > 0 && qlen > recorder->m_dumpQueue;
+        if (above && !q.above)
+        {
+            recorder->m_queueTriggers++;
+            recorder->Trigger (now, "queue above dumpQueue");
+        }
+        q.above = above;
+
+        if (recorder->m_dumpJain > 0)
+            recorder->CountFlow (now, item);
+    }
+
+    static void Dropped (FlightRecorder *recorder, uint32_t id, Ptr<const QueueDiscItem> item)
+    {
+        TimedScope timed (Timer ());
+        double now = Simulator::Now ().GetSeconds ();
+        const Queue &q = recorder->m_queues[id];
+        recorder->Push (now, id, DROP, GetOccupancy (q.queue, q.bytes), item);
+
+        // The oldest of the last dumpDrops drop times tells whether they fit in one window
+        std::vector<double> &times = recorder->m_dropTimes;
+        if (times.empty ())
+            return;
+        double oldest = times[recorder->m_dropHead];
+        times[recorder->m_dropHead] = now;
+        recorder->m_dropHead = (recorder->m_dropHead + 1) % times.size ();
+        if (oldest >= 0 && now - oldest <= recorder->m_triggerWindow)
+        {
+            recorder->m_dropTriggers++;
+            recorder->Trigger (now, "drop burst");
+        }
+    }
+
+    void Push (double now, uint32_t id, Kind kind, uint32_t qlen, Ptr<const QueueDiscItem> item)
+    {
+        Record &r = m_ring[m_next];
+        TcpFields tcp;
+        bool isTcp = PeekTcp (item, tcp);
+        r.time = now;
+        r.seq = isTcp ? tcp.sequence : 0;
+        r.port = isTcp ? tcp.destinationPort : 0;
+        r.qlen = qlen;
+        r.queue = id;
+        r.kind = kind;
+        m_next = (m_next + 1) % m_ring.size ();
+        if (m_count < m_ring.size ())
+            m_count++;
+    }
+
+    // Enqueued bytes per flow in the current trigger window
+    void CountFlow (double now, Ptr<const QueueDiscItem> item)
+    {
+        if (now >= m_binStart + m_triggerWindow)
+            CloseBin (now);
+        FlowKey key;
+        TcpFields tcp;
+        if (!FlowIndex::KeyOf (item, key, tcp))
+            return;
+        bool isNew;
+        uint32_t flow = m_flows.Find (key, isNew);
+        if (isNew)
+            m_bytes.push_back (0);
+        m_bytes[flow] += item->GetSize ();
+    }
+
+    // Checks the Jain index of the window that just ended and forgets its
+    // flows
+    void CloseBin (double now)
+    {
+        double sum = 0;
+        double sumSq = 0;
+        for (uint64_t bytes : m_bytes)
+        {
+            double x = bytes;
+            sum += x;
+            sumSq += x * x;
+        }
+        size_t n = m_bytes.size ();
+        m_flows.Clear ();
+        m_bytes.clear ();
+        m_binStart += m_triggerWindow * std::floor ((now - m_binStart) / m_triggerWindow);
+        if (n >= 2 && sum * sum / (n * sumSq) < m_dumpJain)
+        {
+            m_fairnessTriggers++;
+            Trigger (now, "fairness collapse");
+        }
+    }
+
+    void Trigger (double now, const char *reason)
+    {
+        if (now < m_quietUntil || m_dumps >= m_maxDumps)
+            return;
+        m_quietUntil = now + m_window;
+        Dump (now, reason);
+    }
+
+    void Dump (double now, const char *reason)
+    {
+        char name[32];
+        std::snprintf (name, sizeof (name), "/dump-%03u.txt", m_dumps++);
+        FILE *f = std::fopen ((m_pathOut + name).c_str (), "w");
+        if (!f)
+            return;
+        std::fprintf (f, "# %s at %.9g, last %g s\n", reason, now, m_window);
+        size_t first = (m_next + m_ring.size () - m_count) % m_ring.size ();
+        for (size_t n = 0; n < m_count; ++n)
+        {
+            const Record &r = m_ring[(first + n) % m_ring.size ()];
+            if (r.time < now - m_window)
+                continue;
+            std::fprintf (f, "%c %.9g %u %u %u %u\n", r.kind == DROP ? 'D' : 'A', r.time, r.queue, r.qlen, r.seq,
+                          r.port);
+        }
+        std::fclose (f);
+    }
+
+    double m_window;
+    uint32_t m_capacity;
+    uint32_t m_dumpDrops;
+    double m_dumpQueue;
+    double m_dumpJain;
+    double m_triggerWindow;
+    uint32_t m_maxDumps;
+    std::string m_pathOut;
+
+    std::vector<Queue> m_queues;
+    std::vector<Record> m_ring;
+    size_t m_next;
+    size_t m_count;
+
+    std::vector<double> m_dropTimes;
+    size_t m_dropHead;
+    double m_quietUntil;
+
+    FlowIndex m_flows;
+    std::vector<uint64_t> m_bytes;
+    double m_binStart;
+
+    uint32_t m_dumps;
+    uint32_t m_dropTriggers;
+    uint32_t m_queueTriggers;
+    uint32_t m_fairnessTriggers;
+};
+
+} // namespace ns3
+
+#endif /* RED_FLIGHT_RECORDER_H */
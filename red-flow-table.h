@@ -0,0 +1,369 @@
+/** Per-flow accounting at the RED queues
+ *
+ * FlowTable keeps per-flow byte counters keyed by the TCP 5-tuple. A
+ * FlowIndex maps tuples to dense ids through an open-addressing hash table
+ * (linear probing, power-of-two size). Counters live in flat arrays indexed
+ * by flow id, so a packet costs one probe and three additions; memory is
+ * only allocated when a new flow shows up.
+ *
+ * Time is cut into fixed bins. For every bin and every flow that was seen
+ * in it, the table records the bytes enqueued, dropped and delivered
+ * (dequeued onto the link), the delivered bytes that carried an ECN
+ * Congestion Experienced mark, plus a Jain fairness index over the
+ * delivered bytes of those flows:
+ *
+ *   J = (sum x)^2 / (n * sum x^2)
+ *
+ * Pure ACKs are not counted, so the reverse direction of a flow does not
+ * show up as a flow of its own.
+ *
+ * The output is one text file with tagged lines:
+ *   W <binWidth>                               first line
+ *   F <id> <src> <sport> <dst> <dport>         once per flow
+ *   B <binStart> <jain> <flows>                once per non-empty bin
+ *   R <binStart> <id> <enq> <drop> <deliv> <mark>   bytes per flow in that bin
+ * plotflows.py turns it into throughput and fairness plots.
+ */
+
+#ifndef RED_FLOW_TABLE_H
+#define RED_FLOW_TABLE_H
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "ns3/core-module.h"
+#include "ns3/internet-module.h"
+#include "ns3/traffic-control-module.h"
+
+#include "red-profile.h"
+#include "red-tcp-peek.h"
+
+namespace ns3 {
+
+struct FlowKey
+{
+    uint32_t src;
+    uint32_t dst;
+    uint16_t sport;
+    uint16_t dport;
+    uint8_t proto;
+
+    bool operator== (const FlowKey &o) const
+    {
+        return src == o.src && dst == o.dst && sport == o.sport && dport == o.dport && proto == o.proto;
+    }
+
+    uint64_t Hash () const
+    {
+        uint64_t h = (static_cast<uint64_t> (src) << 32 | dst) * 0x9e3779b97f4a7c15ULL;
+        h ^= (static_cast<uint64_t> (sport) << 24 | static_cast<uint64_t> (dport) << 8 | proto) + (h >> 29);
+        return h * 0xbf58476d1ce4e5b9ULL;
+    }
+};
+
+// Maps 5-tuples to dense ids 0, 1, 2, ... in order of first appearance
+class FlowIndex
+{
+public:
+    FlowIndex ()
+      : m_slots (64, EMPTY),
+        m_mask (63)
+    {
+    }
+
+    // The id of key; isNew tells whether it was just assigned
+    uint32_t Find (const FlowKey &key, bool &isNew)
+    {
+        uint64_t i = key.Hash () & m_mask;
+        while (m_slots[i] != EMPTY)
+        {
+            if (m_keys[m_slots[i]] == key)
+            {
+                isNew = false;
+                return m_slots[i];
+            }
+            i = (i + 1) & m_mask;
+        }
+
+        isNew = true;
+        uint32_t flow = m_keys.size ();
+        m_slots[i] = flow;
+        m_keys.push_back (key);
+        if (2 * m_keys.size () > m_slots.size ())
+            Grow ();
+        return flow;
+    }
+
+    uint32_t GetN () const
+    {
+        return m_keys.size ();
+    }
+
+    const FlowKey &Get (uint32_t flow) const
+    {
+        return m_keys[flow];
+    }
+
+    // Forgets every flow; ids start over at 0. The table keeps its size.
+    void Clear ()
+    {
+        if (m_keys.empty ())
+            return;
+        m_slots.assign (m_slots.size (), EMPTY);
+        m_keys.clear ();
+    }
+
+    // The data-direction 5-tuple of a TCP segment; false for anything else
+    // and for pure ACKs
+    static bool KeyOf (Ptr<const QueueDiscItem> item, FlowKey &key, TcpFields &tcp)
+    {
+        Ptr<const Ipv4QueueDiscItem> ipItem = DynamicCast<const Ipv4QueueDiscItem> (item);
+        if (!ipItem)
+            return false;
+        const Ipv4Header &ip = ipItem->GetHeader ();
+        if (ip.GetProtocol () != TcpL4Protocol::PROT_NUMBER)
+            return false;
+        if (!PeekTcp (item->GetPacket (), tcp) || tcp.payloadLength == 0)
+            return false;
+        key.src = ip.GetSource ().Get ();
+        key.dst = ip.GetDestination ().Get ();
+        key.sport = tcp.sourcePort;
+        key.dport = tcp.destinationPort;
+        key.proto = ip.GetProtocol ();
+        return true;
+    }
+
+    static std::string Address (uint32_t ip)
+    {
+        char text[16];
+        std::snprintf (text, sizeof (text), "%u.%u.%u.%u", ip >> 24, (ip >> 16) & 0xff, (ip >> 8) & 0xff, ip & 0xff);
+        return text;
+    }
+
+private:
+    static const uint32_t EMPTY = 0xffffffff;
+
+    void Grow ()
+    {
+        m_slots.assign (2 * m_slots.size (), EMPTY);
+        m_mask = m_slots.size () - 1;
+        for (uint32_t flow = 0; flow < m_keys.size (); ++flow)
+        {
+            uint64_t i = m_keys[flow].Hash () & m_mask;
+            while (m_slots[i] != EMPTY)
+                i = (i + 1) & m_mask;
+            m_slots[i] = flow;
+        }
+    }
+
+    std::vector<uint32_t> m_slots;
+    uint64_t m_mask;
+    std::vector<FlowKey> m_keys;
+};
+
+// The ECN codepoint of an IPv4 item; Not-ECT for anything else
+inline Ipv4Header::EcnType
+GetEcn (Ptr<const QueueDiscItem> item)
+{
+    Ptr<const Ipv4QueueDiscItem> ipItem = DynamicCast<const Ipv4QueueDiscItem> (item);
+    return ipItem ? ipItem->GetHeader ().GetEcn () : Ipv4Header::ECN_NotECT;
+}
+
+class FlowTable
+{
+public:
+    FlowTable ()
+      : m_file (nullptr),
+        m_binWidth (0.1),
+        m_binStart (0),
+        m_bins (0)
+    {
+    }
+
+    ~FlowTable ()
+    {
+        Finish (m_binStart + m_binWidth);
+    }
+
+    bool Open (const std::string &path, double binWidth)
+    {
+        m_file = std::fopen (path.c_str (), "w");
+        m_binWidth = binWidth;
+        m_binStart = 0;
+        if (!m_file)
+            return false;
+        std::fprintf (m_file, "W %g\n", binWidth);
+        return true;
+    }
+
+    bool IsOpen () const
+    {
+        return m_file != nullptr;
+    }
+
+    // Counts every data packet passing through queue
+    void Connect (Ptr<QueueDisc> queue)
+    {
+        queue->TraceConnectWithoutContext ("Enqueue", MakeCallback (&FlowTable::Enqueued, this));
+        queue->TraceConnectWithoutContext ("Drop", MakeCallback (&FlowTable::Dropped, this));
+        queue->TraceConnectWithoutContext ("Dequeue", MakeCallback (&FlowTable::Delivered, this));
+    }
+
+    // Writes the last bin ending at time and closes the file
+    void Finish (double time)
+    {
+        if (!m_file)
+            return;
+        while (m_binStart + m_binWidth <= time)
+            CloseBin ();
+        if (!m_touched.empty ())
+            CloseBin ();
+        std::fclose (m_file);
+        m_file = nullptr;
+    }
+
+    uint32_t GetFlowCount () const
+    {
+        return m_index.GetN ();
+    }
+
+    // Jain index over the bytes each flow got through the queue in the whole run
+    double GetJainIndex () const
+    {
+        return Jain (m_total, nullptr);
+    }
+
+    uint64_t GetDelivered (uint32_t flow) const
+    {
+        return m_total[flow];
+    }
+
+private:
+    enum Counter
+    {
+        ENQUEUED = 0,
+        DROPPED = 1,
+        DELIVERED = 2,
+        MARKED = 3,
+        COUNTERS = 4
+    };
+
+    void Enqueued (Ptr<const QueueDiscItem> item)
+    {
+        Count (item, ENQUEUED);
+    }
+
+    void Dropped (Ptr<const QueueDiscItem> item)
+    {
+        Count (item, DROPPED);
+    }
+
+    void Delivered (Ptr<const QueueDiscItem> item)
+    {
+        Count (item, DELIVERED);
+    }
+
+    static CallbackTimer &Timer ()
+    {
+        static CallbackTimer timer ("FlowTable");
+        return timer;
+    }
+
+    void Count (Ptr<const QueueDiscItem> item, Counter counter)
+    {
+        if (!m_file)
+            return;
+        TimedScope timed (Timer ());
+
+        FlowKey key;
+        TcpFields tcp;
+        if (!FlowIndex::KeyOf (item, key, tcp))
+            return;
+
+        double now = Simulator::Now ().GetSeconds ();
+        while (now >= m_binStart + m_binWidth)
+            CloseBin ();
+
+        uint32_t flow = Find (key);
+        if (m_seenIn[flow] != m_bins + 1)
+        {
+            m_seenIn[flow] = m_bins + 1;
+            m_touched.push_back (flow);
+        }
+        uint32_t bytes = item->GetSize ();
+        m_bin[COUNTERS * flow + counter] += bytes;
+        if (counter == DELIVERED)
+        {
+            m_total[flow] += bytes;
+            // Marks are made on enqueue, so they are visible from here on
+            if (GetEcn (item) == Ipv4Header::ECN_CE)
+                m_bin[COUNTERS * flow + MARKED] += bytes;
+        }
+    }
+
+    uint32_t Find (const FlowKey &key)
+    {
+        bool isNew;
+        uint32_t flow = m_index.Find (key, isNew);
+        if (!isNew)
+            return flow;
+
+        m_bin.resize (COUNTERS * m_index.GetN (), 0);
+        m_total.push_back (0);
+        m_seenIn.push_back (0);
+        std::fprintf (m_file, "F %u %s %u %s %u\n", flow, FlowIndex::Address (key.src).c_str (), key.sport,
+                      FlowIndex::Address (key.dst).c_str (), key.dport);
+        return flow;
+    }
+
+    void CloseBin ()
+    {
+        if (!m_touched.empty ())
+        {
+            std::fprintf (m_file, "B %g %.6f %u\n", m_binStart, Jain (m_bin, &m_touched),
+                          static_cast<uint32_t> (m_touched.size ()));
+            for (uint32_t flow : m_touched)
+            {
+                uint64_t *c = &m_bin[COUNTERS * flow];
+                std::fprintf (m_file, "R %g %u %llu %llu %llu %llu\n", m_binStart, flow,
+                              (unsigned long long) c[ENQUEUED], (unsigned long long) c[DROPPED],
+                              (unsigned long long) c[DELIVERED], (unsigned long long) c[MARKED]);
+                c[ENQUEUED] = c[DROPPED] = c[DELIVERED] = c[MARKED] = 0;
+            }
+            m_touched.clear ();
+        }
+        m_bins++;
+        m_binStart = m_bins * m_binWidth;
+    }
+
+    // Over the listed flows of a per-bin table, or over every entry of a per-flow total
+    double Jain (const std::vector<uint64_t> &bytes, const std::vector<uint32_t> *flows) const
+    {
+        size_t n = flows ? flows->size () : bytes.size ();
+        double sum = 0;
+        double sumSq = 0;
+        for (size_t i = 0; i < n; ++i)
+        {
+            double x = flows ? bytes[COUNTERS * (*flows)[i] + DELIVERED] : bytes[i];
+            sum += x;
+            sumSq += x * x;
+        }
+        return sumSq > 0 ? sum * sum / (n * sumSq) : 0.0;
+    }
+
+    FILE *m_file;
+    double m_binWidth;
+    double m_binStart;
+    FlowIndex m_index;
+    std::vector<uint64_t> m_bin;
+    std::vector<uint64_t> m_total;
+    std::vector<uint64_t> m_seenIn;
+    std::vector<uint32_t> m_touched;
+    uint64_t m_bins;
+};
+
+} // namespace ns3
+
+#endif /* RED_FLOW_TABLE_H */
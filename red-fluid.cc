@@ -0,0 +1,213 @@
+/** Fluid-model screen of RED settings
+ *
+ * Solves the fluid model of red-fluid.h for every combination of the
+ * --minTh, --maxTh and --qw lists on the topology of a scenario file, and
+ * ranks the combinations by the predicted mean queue, drop probability
+ * and throughput. Each one takes milliseconds, so thousands of them cost
+ * less than one packet-level run:
+ *
+ *   ./waf --run "red-fluid --config=scratch/scenarios/p2c.conf
+ *                --minTh=2:20:2 --maxTh=10:80:5 --qw=0.001,0.002,0.005,0.01,0.02"
+ *
+ * A list is "a,b,c" or "from:to:step". <pathOut>/fluid.csv holds every
+ * combination, best first; <pathOut>/fluid-top.csv the best --top ones as
+ * a redsweep.py --list file, to run them at packet level:
+ *
+ *   python3 redsweep.py --program p2c --list P2cFluid/fluid-top.csv --seeds 1 2 3
+ *
+ * --rank picks the order: power (throughput over the mean round trip,
+ * the default), throughput, delay or drops.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <sys/stat.h>
+
+#include "ns3/core-module.h"
+
+#include "red-fluid.h"
+#include "red-scenario-config.h"
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("RedFluid");
+
+struct Candidate
+{
+    FluidRed red;
+    FluidResult result;
+    double score;
+};
+
+// "a,b,c" or "from:to:step"
+static bool
+ParseValues (const std::string &text, std::vector<double> &values)
+{
+    values.clear ();
+    std::vector<std::string> parts;
+    std::istringstream in (text);
+    std::string part;
+    if (text.find (':') != std::string::npos)
+    {
+        while (std::getline (in, part, ':'))
+            parts.push_back (part);
+        if (parts.size () != 3)
+            return false;
+        double from = std::atof (parts[0].c_str ());
+        double to = std::atof (parts[1].c_str ());
+        double step = std::atof (parts[2].c_str ());
+        if (step <= 0)
+            return false;
+        for (double v = from; v <= to + step * 1e-9; v += step)
+            values.push_back (v);
+    }
+    else
+    {
+        while (std::getline (in, part, ','))
+            if (!part.empty ())
+                values.push_back (std::atof (part.c_str ()));
+    }
+    return !values.empty ();
+}
+
+static double
+Score (const std::string &rank, const FluidResult &r)
+{
+    if (rank == "throughput")
+        return r.throughputMbps;
+    if (rank == "delay")
+        return -r.delayMs;
+    if (rank == "drops")
+        return -r.dropProb;
+    return r.rttMs > 0 ? r.throughputMbps / r.rttMs : 0.0;
+}
+
+int
+main (int argc, char *argv[])
+{
+    std::string configPath = "scratch/scenarios/p2c.conf";
+    std::string pathOut = "RedFluid";
+    std::string minThList;
+    std::string maxThList;
+    std::string qwList;
+    double queueLimit = -1;
+    double lInterm = 50;
+    double stopTime = -1;
+    double warmup = 0;
+    double step = 1e-4;
+    std::string rank = "power";
+    uint32_t top = 20;
+
+    CommandLine cmd;
+    cmd.AddValue ("config", "Scenario file describing nodes, links, queues and flows", configPath);
+    cmd.AddValue ("pathOut", "Directory for fluid.csv and fluid-top.csv", pathOut);
+    cmd.AddValue ("minTh", "RED minimum thresholds to try, \"a,b,c\" or \"from:to:step\" (default: the scenario's)", minThList);
+    cmd.AddValue ("maxTh", "RED maximum thresholds to try (default: the scenario's)", maxThList);
+    cmd.AddValue ("qw", "RED queue weights to try (default: the scenario's)", qwList);
+    cmd.AddValue ("maxPackets", "Queue limit (packets), overrides the scenario file", queueLimit);
+    cmd.AddValue ("lInterm", "RED's LInterm, the drop probability at maxTh is 1/lInterm", lInterm);
+    cmd.AddValue ("stopTime", "Seconds to solve, overrides the scenario file", stopTime);
+    cmd.AddValue ("warmup", "Seconds left out of the averages", warmup);
+    cmd.AddValue ("step", "Integration step (seconds)", step);
+    cmd.AddValue ("rank", "<power/throughput/delay/drops> order of the candidates", rank);
+    cmd.AddValue ("top", "Candidates written to fluid-top.csv", top);
+    cmd.Parse (argc, argv);
+    NS_ABORT_MSG_UNLESS (rank == "power" || rank == "throughput" || rank == "delay" || rank == "drops",
+                         "--rank must be power, throughput, delay or drops");
+
+    ScenarioConfig config;
+    std::string error;
+    if (!config.Load (configPath, error))
+        NS_FATAL_ERROR (error);
+    FluidModel model;
+    model.SetStep (step);
+    if (!model.Build (config, error))
+        NS_FATAL_ERROR (error);
+
+    // The scenario's RED line is the default of every list
+    std::map<std::string, std::string> &red = config.red;
+    FluidRed base;
+    if (red.count ("minTh"))
+        base.minTh = std::atof (red["minTh"].c_str ());
+    if (red.count ("maxTh"))
+        base.maxTh = std::atof (red["maxTh"].c_str ());
+    if (red.count ("qw"))
+        base.qw = std::atof (red["qw"].c_str ());
+    if (red.count ("queueLimit"))
+        base.queueLimit = std::atof (red["queueLimit"].c_str ());
+    if (red.count ("gentle"))
+        base.gentle = std::atoi (red["gentle"].c_str ()) != 0;
+    if (queueLimit > 0)
+        base.queueLimit = queueLimit;
+    base.maxP = 1 / lInterm;
+    if (stopTime < 0)
+        stopTime = config.GetSetting ("stopTime", 1.0);
+
+    std::vector<double> minThs (1, base.minTh);
+    std::vector<double> maxThs (1, base.maxTh);
+    std::vector<double> qws (1, base.qw);
+    NS_ABORT_MSG_UNLESS (minThList.empty () || ParseValues (minThList, minThs), "bad --minTh list " << minThList);
+    NS_ABORT_MSG_UNLESS (maxThList.empty () || ParseValues (maxThList, maxThs), "bad --maxTh list " << maxThList);
+    NS_ABORT_MSG_UNLESS (qwList.empty () || ParseValues (qwList, qws), "bad --qw list " << qwList);
+
+    std::vector<Candidate> candidates;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now ();
+    for (double minTh : minThs)
+        for (double maxTh : maxThs)
+            for (double qw : qws)
+            {
+                if (maxTh <= minTh || qw <= 0 || qw >= 1)
+                    continue;
+                Candidate c;
+                c.red = base;
+                c.red.minTh = minTh;
+                c.red.maxTh = maxTh;
+                c.red.qw = qw;
+                c.result = model.Solve (c.red, stopTime, warmup);
+                c.score = Score (rank, c.result);
+                candidates.push_back (c);
+            }
+    double seconds = std::chrono::duration<double> (std::chrono::steady_clock::now () - start).count ();
+    NS_ABORT_MSG_IF (candidates.empty (), "no candidate has minTh < maxTh and 0 < qw < 1");
+
+    std::stable_sort (candidates.begin (), candidates.end (),
+                      [] (const Candidate &a, const Candidate &b) { return a.score > b.score; });
+
+    mkdir (pathOut.c_str (), 0777);
+    FILE *all = std::fopen ((pathOut + "/fluid.csv").c_str (), "w");
+    FILE *best = std::fopen ((pathOut + "/fluid-top.csv").c_str (), "w");
+    NS_ABORT_MSG_UNLESS (all && best, "cannot write into " << pathOut);
+    std::fprintf (all, "minTh,maxTh,qw,meanQueue,dropProb,throughputMbps,delayMs,rttMs,score\n");
+    std::fprintf (best, "minTh,maxTh,qw\n");
+    for (size_t i = 0; i < candidates.size (); ++i)
+    {
+        const Candidate &c = candidates[i];
+        std::fprintf (all, "%g,%g,%g,%.6g,%.6g,%.6g,%.6g,%.6g,%.6g\n", c.red.minTh, c.red.maxTh, c.red.qw,
+                      c.result.meanQueue, c.result.dropProb, c.result.throughputMbps, c.result.delayMs, c.result.rttMs,
+                      c.score);
+        if (i < top)
+            std::fprintf (best, "%g,%g,%g\n", c.red.minTh, c.red.maxTh, c.red.qw);
+    }
+    std::fclose (all);
+    std::fclose (best);
+
+    std::cout << "\tFlows\t" << model.GetNFlows () << "\tClasses\t" << model.GetNClasses () << "\tQueues\t" << model.GetNQueues () << "\tCandidates\t"
+              << candidates.size () << "\tSolved in\t" << seconds * 1e3 << " ms" << std::endl;
+    for (size_t i = 0; i < candidates.size () && i < 5; ++i)
+    {
+        const Candidate &c = candidates[i];
+        std::cout << "\tminTh\t" << c.red.minTh << "\tmaxTh\t" << c.red.maxTh << "\tqw\t" << c.red.qw
+                  << "\tmeanQueue\t" << c.result.meanQueue << "\tdropProb\t" << c.result.dropProb
+                  << "\tthroughputMbps\t" << c.result.throughputMbps << std::endl;
+    }
+
+    return 0;
+}
@@ -0,0 +1,409 @@
+/** Fluid model of TCP flows through RED queues
+ *
+ * Solves the delay differential equations of Misra, Gong and Towsley for
+ * the topology of a scenario file (see red-scenario-config.h): one window
+ * W per flow and, per RED queue, the queue length q and its average x.
+ *
+ *   dW/dt = 1/R - W(t) W(t-R) / (2 R(t-R)) p(t-R)
+ *   dq/dt = sum over the flows through the queue of (1 - p_red) W/R - C
+ *   dx/dt = ln(1 - qw) C (x - q)
+ *
+ * R is the flow's propagation round trip, both directions of its path,
+ * plus the queueing delay q/C of every queue on it. p is the path's drop
+ * probability: RED's curve of x (gentle above maxTh) combined with the
+ * tail drops once q reaches the queue limit. A flow stays in slow start
+ * (dW/dt = W/R) until it expects its first drop, and W is held to the
+ * receive buffer and to the flow's source rate times R.
+ *
+ * Only RED queues are modelled and ACK traffic is ignored; links without a
+ * queue directive are taken to be no bottleneck. Solving a one-second run
+ * takes about a millisecond, which makes the model a screen that ranks
+ * thousands of RED settings before the packet-level runs (red-fluid.cc).
+ *
+ * Like red-scenario-config.h this header has no ns-3 dependency.
+ */
+
+#ifndef RED_FLUID_H
+#define RED_FLUID_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "red-scenario-config.h"
+
+namespace ns3 {
+
+struct FluidRed
+{
+    double minTh = 5;
+    double maxTh = 15;
+    double qw = 0.002;
+    double maxP = 0.02;  // 1 / LInterm
+    double queueLimit = 40;
+    bool gentle = true;
+};
+
+struct FluidResult
+{
+    double meanQueue = 0;       // packets, time average, mean over the queues
+    double dropProb = 0;        // dropped over arrived packets, all queues
+    double throughputMbps = 0;  // payload delivered to the sinks
+    double delayMs = 0;         // queueing delay, time average, mean over the queues
+    double rttMs = 0;           // mean round trip of the flows
+};
+
+class FluidModel
+{
+public:
+    FluidModel ()
+      : m_dt (1e-4),
+        m_payloadBits (958 * 8),
+        m_wireBits (1000 * 8),
+        m_maxWindow (131072.0 / 958),
+        m_nFlows (0)
+    {
+    }
+
+    // Step of the Euler integration (seconds)
+    void SetStep (double dt)
+    {
+        m_dt = dt;
+    }
+
+    // Finds every flow's path and the RED queues on it; returns false and
+    // fills error when the scenario has something the model cannot follow
+    bool Build (const ScenarioConfig &config, std::string &error)
+    {
+        std::map<std::string, uint32_t> nodes;
+        for (size_t i = 0; i < config.nodes.size (); ++i)
+            nodes[config.nodes[i]] = i;
+        std::vector<std::vector<Hop> > adjacent (config.nodes.size ());
+        for (const ScenarioLink &link : config.links)
+        {
+            Hop ab = {nodes[link.b], ScenarioConfig::ParseDelay (link.delay), ScenarioConfig::ParseRate (link.rate)};
+            Hop ba = {nodes[link.a], ab.delay, ab.rate};
+            adjacent[nodes[link.a]].push_back (ab);
+            adjacent[nodes[link.b]].push_back (ba);
+        }
+
+        double payload = config.GetSetting ("packetSize", 1000.0 - 42);
+        m_payloadBits = payload * 8;
+        m_wireBits = (payload + 42) * 8;
+        m_maxWindow = config.GetSetting ("tcpBufferSize", 131072.0) / payload;
+        double sourceRate = ScenarioConfig::ParseRate (config.GetSetting ("sourceRate", std::string ("100Mbps")));
+
+        m_queues.clear ();
+        std::map<std::pair<uint32_t, uint32_t>, uint32_t> queueOf;
+        for (const ScenarioQueue &q : config.queues)
+        {
+            if (q.type != "red" && q.type != "ared")
+            {
+                error = "queue " + q.from + "->" + q.to + ": the fluid model covers RED only, not " + q.type;
+                return false;
+            }
+            uint32_t from = nodes[q.from];
+            uint32_t to = nodes[q.to];
+            Queue queue;
+            queue.capacity = 0;
+            for (const Hop &hop : adjacent[from])
+                if (hop.to == to)
+                    queue.capacity = hop.rate / m_wireBits;
+            if (queue.capacity <= 0)
+            {
+                error = "queue " + q.from + "->" + q.to + " is not on a link";
+                return false;
+            }
+            queueOf[std::make_pair (from, to)] = m_queues.size ();
+            m_queues.push_back (queue);
+        }
+
+        m_flows.clear ();
+        m_nFlows = 0;
+        for (const ScenarioFlow &f : config.flows)
+        {
+            if (!f.workload.empty () && f.workload != "bulk")
+            {
+                error = "flow " + f.src + "->" + f.dst + ": the fluid model covers bulk flows only, not " + f.workload;
+                return false;
+            }
+            std::vector<uint32_t> path;
+            std::vector<double> delays;
+            if (!ShortestPath (adjacent, nodes[f.src], nodes[f.dst], path, delays))
+            {
+                error = "no path from " + f.src + " to " + f.dst;
+                return false;
+            }
+            Flow flow;
+            flow.start = f.start;
+            flow.stop = f.stop;
+            flow.baseRtt = 0;
+            for (size_t h = 0; h + 1 < path.size (); ++h)
+            {
+                flow.baseRtt += 2 * delays[h];
+                std::map<std::pair<uint32_t, uint32_t>, uint32_t>::const_iterator it =
+                    queueOf.find (std::make_pair (path[h], path[h + 1]));
+                if (it != queueOf.end ())
+                    flow.queues.push_back (it->second);
+            }
+            flow.maxRate = (f.rate.empty () ? sourceRate : ScenarioConfig::ParseRate (f.rate)) / m_wireBits;
+            flow.weight = 1;
+            AddFlow (flow);
+        }
+        if (m_flows.empty ())
+        {
+            error = "the scenario has no flows";
+            return false;
+        }
+        return true;
+    }
+
+    // Integrates from 0 to stopTime; the averages cover warmup to stopTime
+    FluidResult Solve (const FluidRed &red, double stopTime, double warmup = 0) const
+    {
+        size_t nFlows = m_flows.size ();
+        size_t nQueues = m_queues.size ();
+
+        // Ring of past states, long enough for the largest round trip
+        double maxRtt = 0;
+        for (const Flow &f : m_flows)
+        {
+            double rtt = f.baseRtt;
+            for (uint32_t q : f.queues)
+                rtt += red.queueLimit / m_queues[q].capacity;
+            maxRtt = std::max (maxRtt, rtt);
+        }
+        size_t depth = static_cast<size_t> (maxRtt / m_dt) + 2;
+        std::vector<double> pastRate (depth * nFlows, 0.0);  // W/R
+        std::vector<double> pastLoss (depth * nFlows, 0.0);  // path drop probability
+
+        std::vector<double> w (nFlows, 1.0);
+        std::vector<double> rtt (nFlows);
+        std::vector<double> loss (nFlows);
+        std::vector<double> expectedDrops (nFlows, 0.0);
+        std::vector<double> q (nQueues, 0.0);
+        std::vector<double> x (nQueues, 0.0);
+        std::vector<double> arrival (nQueues);
+        std::vector<double> pRed (nQueues);
+        std::vector<double> pTail (nQueues);
+        double decay = std::log (1 - red.qw);
+
+        double queueSum = 0;
+        double delaySum = 0;
+        double rttSum = 0;
+        double arrived = 0;
+        double dropped = 0;
+        double delivered = 0;
+        double measured = 0;
+
+        size_t steps = static_cast<size_t> (stopTime / m_dt);
+        for (size_t k = 0; k < steps; ++k)
+        {
+            double t = k * m_dt;
+            size_t slot = k % depth;
+
+            // Drop probabilities seen by each queue's arrivals now
+            for (size_t j = 0; j < nQueues; ++j)
+            {
+                pRed[j] = RedProbability (red, x[j]);
+                pTail[j] = 0;
+                arrival[j] = 0;
+            }
+            for (size_t i = 0; i < nFlows; ++i)
+            {
+                const Flow &f = m_flows[i];
+                rtt[i] = f.baseRtt;
+                for (uint32_t j : f.queues)
+                    rtt[i] += q[j] / m_queues[j].capacity;
+                bool active = t >= f.start && (f.stop < 0 || t < f.stop);
+                double rate = active ? std::min (w[i] / rtt[i], f.maxRate) : 0.0;
+                pastRate[slot * nFlows + i] = rate;
+                for (uint32_t j : f.queues)
+                    arrival[j] += f.weight * rate;
+            }
+            for (size_t j = 0; j < nQueues; ++j)
+            {
+                double accepted = arrival[j] * (1 - pRed[j]);
+                if (q[j] >= red.queueLimit && accepted > m_queues[j].capacity)
+                    pTail[j] = 1 - m_queues[j].capacity / accepted;
+            }
+
+            // Windows react to what was dropped one round trip ago
+            for (size_t i = 0; i < nFlows; ++i)
+            {
+                const Flow &f = m_flows[i];
+                double keep = 1;
+                for (uint32_t j : f.queues)
+                    keep *= (1 - pRed[j]) * (1 - pTail[j]);
+                loss[i] = 1 - keep;
+                pastLoss[slot * nFlows + i] = loss[i];
+
+                double rate = pastRate[slot * nFlows + i];
+                if (rate == 0)
+                    continue;
+                size_t back = std::min (static_cast<size_t> (rtt[i] / m_dt), depth - 1);
+                size_t then = (slot + depth - back) % depth;
+                double rateThen = k >= back ? pastRate[then * nFlows + i] : 0.0;
+                double lossThen = k >= back ? pastLoss[then * nFlows + i] : 0.0;
+
+                double growth = expectedDrops[i] < 1 ? w[i] / rtt[i] : 1 / rtt[i];
+                double dw = growth - w[i] * rateThen * lossThen / 2;
+                expectedDrops[i] += rateThen * lossThen * m_dt;
+                w[i] = std::max (1.0, std::min (w[i] + dw * m_dt, std::min (m_maxWindow, f.maxRate * rtt[i])));
+
+                if (t >= warmup)
+                    delivered += f.weight * rate * keep * m_dt;
+            }
+
+            for (size_t j = 0; j < nQueues; ++j)
+            {
+                double capacity = m_queues[j].capacity;
+                double accepted = arrival[j] * (1 - pRed[j]) * (1 - pTail[j]);
+                q[j] = std::max (0.0, std::min (red.queueLimit, q[j] + (accepted - capacity) * m_dt));
+                x[j] = q[j] + (x[j] - q[j]) * std::exp (decay * capacity * m_dt);
+                if (t >= warmup)
+                {
+                    queueSum += q[j];
+                    delaySum += q[j] / capacity;
+                    arrived += arrival[j] * m_dt;
+                    dropped += (arrival[j] - accepted) * m_dt;
+                }
+            }
+            if (t >= warmup)
+            {
+                double sum = 0;
+                for (size_t i = 0; i < nFlows; ++i)
+                    sum += m_flows[i].weight * rtt[i];
+                rttSum += sum / m_nFlows;
+                measured++;
+            }
+        }
+
+        FluidResult result;
+        if (measured == 0)
+            return result;
+        double duration = measured * m_dt;
+        result.meanQueue = nQueues > 0 ? queueSum / measured / nQueues : 0.0;
+        result.delayMs = nQueues > 0 ? delaySum / measured / nQueues * 1e3 : 0.0;
+        result.dropProb = arrived > 0 ? dropped / arrived : 0.0;
+        result.throughputMbps = delivered * m_payloadBits / duration / 1e6;
+        result.rttMs = rttSum / measured * 1e3;
+        return result;
+    }
+
+    size_t GetNFlows () const
+    {
+        return m_nFlows;
+    }
+
+    // Flows that share path, start, stop and rate are solved once
+    size_t GetNClasses () const
+    {
+        return m_flows.size ();
+    }
+
+    size_t GetNQueues () const
+    {
+        return m_queues.size ();
+    }
+
+private:
+    struct Hop
+    {
+        uint32_t to;
+        double delay;
+        double rate;
+    };
+
+    struct Queue
+    {
+        double capacity;  // packets per second
+    };
+
+    struct Flow
+    {
+        double start;
+        double stop;
+        double baseRtt;
+        double maxRate;  // packets per second
+        std::vector<uint32_t> queues;
+        uint32_t weight;  // identical flows this one stands for
+    };
+
+    void AddFlow (const Flow &flow)
+    {
+        m_nFlows++;
+        for (Flow &f : m_flows)
+        {
+            if (f.queues == flow.queues && f.baseRtt == flow.baseRtt && f.start == flow.start && f.stop == flow.stop
+                && f.maxRate == flow.maxRate)
+            {
+                f.weight++;
+                return;
+            }
+        }
+        m_flows.push_back (flow);
+    }
+
+    // ns-3's RED in packet mode, with the gentle ramp to 1 at 2 maxTh
+    static double RedProbability (const FluidRed &red, double avg)
+    {
+        if (avg < red.minTh)
+            return 0;
+        if (avg < red.maxTh)
+            return red.maxP * (avg - red.minTh) / (red.maxTh - red.minTh);
+        if (red.gentle && avg < 2 * red.maxTh)
+            return red.maxP + (1 - red.maxP) * (avg - red.maxTh) / red.maxTh;
+        return 1;
+    }
+
+    // Fewest hops, as global routing picks them
+    static bool ShortestPath (const std::vector<std::vector<Hop> > &adjacent, uint32_t src, uint32_t dst,
+                              std::vector<uint32_t> &path, std::vector<double> &delays)
+    {
+        std::vector<int64_t> previous (adjacent.size (), -1);
+        std::vector<double> delay (adjacent.size (), 0);
+        std::vector<uint32_t> frontier (1, src);
+        previous[src] = src;
+        for (size_t head = 0; head < frontier.size () && previous[dst] < 0; ++head)
+        {
+            uint32_t u = frontier[head];
+            for (const Hop &hop : adjacent[u])
+            {
+                if (previous[hop.to] >= 0)
+                    continue;
+                previous[hop.to] = u;
+                delay[hop.to] = hop.delay;
+                frontier.push_back (hop.to);
+            }
+        }
+        if (previous[dst] < 0)
+            return false;
+        path.clear ();
+        delays.clear ();
+        for (uint32_t v = dst; v != src; v = previous[v])
+        {
+            path.push_back (v);
+            delays.push_back (delay[v]);
+        }
+        path.push_back (src);
+        std::reverse (path.begin (), path.end ());
+        std::reverse (delays.begin (), delays.end ());
+        return true;
+    }
+
+    double m_dt;
+    double m_payloadBits;
+    double m_wireBits;
+    double m_maxWindow;
+    std::vector<Queue> m_queues;
+    std::vector<Flow> m_flows;
+    size_t m_nFlows;
+};
+
+} // namespace ns3
+
+#endif /* RED_FLUID_H */
@@ -0,0 +1,336 @@
+/** Warm-started variants by fork ()
+ *
+ * Every run spends its first few hundred milliseconds in TCP slow start,
+ * which the statistics then have to discard. With a WarmFork the program
+ * simulates that warm-up once: at the warm-up time an event fork ()s one
+ * child process per variant. Each child applies its variant and carries
+ * on from the shared state to the stop time, while the parent only waits
+ * for the children and then stops. Memory is shared copy-on-write, so N
+ * variants cost one warm-up plus N steady-state segments.
+ *
+ * A variant is a comma-separated list of name=value:
+ *
+ *   runNumber=3     reseeds the drop decisions of the queue discs
+ *   qw=0.02         RED's queue weight
+ *   Target=10ms     any other capitalised name is an attribute set on
+ *                   every monitored disc that has it (PIE, CoDel, ...)
+ *
+ * Variants are separated by ';', or listed one per line in a file given
+ * as "@path". RED derives its drop curve from MinTh, MaxTh, LInterm and
+ * the link when the disc is initialised, so those cannot change after the
+ * fork; sweep them with redsweep.py as before.
+ *
+ * Children are not threads: nothing but the simulator thread may be
+ * running at the fork (no --asyncTrace writer), and files opened before
+ * the fork would be shared by every child, so the programs turn the plot
+ * traces off and write each child's summary into <pathOut>/variant-NNN.
+ */
+
+#ifndef RED_FORK_H
+#define RED_FORK_H
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "ns3/core-module.h"
+#include "ns3/traffic-control-module.h"
+
+#include "red-run-summary.h"
+
+namespace ns3 {
+
+class WarmFork
+{
+public:
+    typedef std::vector<std::pair<std::string, std::string> > Variant;
+    typedef std::function<void (uint32_t variant)> Enter;
+
+    WarmFork ()
+      : m_warmup (0),
+        m_jobs (0),
+        m_role (SINGLE),
+        m_variant (0),
+        m_failed (0)
+    {
+    }
+
+    // Returns false and fills error on a malformed spec
+    bool Parse (const std::string &spec, std::string &error)
+    {
+        m_variants.clear ();
+        std::vector<std::string> lines;
+        if (!spec.empty () && spec[0] == '@')
+        {
+            std::ifstream in (spec.substr (1).c_str ());
+            if (!in)
+            {
+                error = "cannot open variant file " + spec.substr (1);
+                return false;
+            }
+            std::string line;
+            while (std::getline (in, line))
+            {
+                size_t hash = line.find ('#');
+                if (hash != std::string::npos)
+                    line.erase (hash);
+                lines.push_back (line);
+            }
+        }
+        else
+            Split (spec, ';', lines);
+
+        for (const std::string &line : lines)
+        {
+            std::vector<std::string> items;
+            Split (line, ',', items);
+            Variant variant;
+            for (std::string item : items)
+            {
+                item = Trim (item);
+                if (item.empty ())
+                    continue;
+                size_t eq = item.find ('=');
+                if (eq == std::string::npos || eq == 0)
+                {
+                    error = "bad variant entry '" + item + "', expected name=value";
+                    return false;
+                }
+                std::string name = item.substr (0, eq);
+                if (name != "runNumber" && name != "qw" && !(name[0] >= 'A' && name[0] <= 'Z'))
+                {
+                    error = "'" + name + "' cannot change after the fork; use runNumber, qw or a queue disc attribute";
+                    return false;
+                }
+                variant.push_back (std::make_pair (name, item.substr (eq + 1)));
+            }
+            if (!variant.empty ())
+                m_variants.push_back (variant);
+        }
+        if (m_variants.empty ())
+        {
+            error = "no variants in '" + spec + "'";
+            return false;
+        }
+        return true;
+    }
+
+    bool IsEnabled () const
+    {
+        return !m_variants.empty ();
+    }
+
+    uint32_t GetN () const
+    {
+        return m_variants.size ();
+    }
+
+    // Forks every variant at warmup seconds, at most jobs of them running at
+    // a time (0 runs them all at once). Each child calls enter from inside
+    // the fork event and then continues the simulation.
+    void Schedule (double warmup, uint32_t jobs, Enter enter)
+    {
+        m_warmup = warmup;
+        m_jobs = jobs;
+        m_enter = enter;
+        Simulator::Schedule (Seconds (warmup), &WarmFork::Fork, this);
+    }
+
+    // After Simulator::Run (): the process that only forked and waited
+    bool IsParent () const
+    {
+        return m_role == PARENT;
+    }
+
+    bool IsChild () const
+    {
+        return m_role == CHILD;
+    }
+
+    uint32_t GetVariant () const
+    {
+        return m_variant;
+    }
+
+    double GetWarmup () const
+    {
+        return m_warmup;
+    }
+
+    // When statistics start: the warm-up in a child, 0 otherwise
+    double GetMeasureStart () const
+    {
+        return IsChild () ? m_warmup : 0.0;
+    }
+
+    uint32_t GetFailed () const
+    {
+        return m_failed;
+    }
+
+    // Creates and returns this child's output directory under pathOut; the
+    // child fails, and is counted by the parent, when it cannot
+    std::string MakeChildPath (const std::string &pathOut) const
+    {
+        char label[32];
+        std::snprintf (label, sizeof (label), "/variant-%03u", m_variant);
+        std::string path = pathOut + label;
+        NS_ABORT_MSG_IF (mkdir (path.c_str (), 0777) != 0 && errno != EEXIST,
+                         "cannot create " << path << ": " << std::strerror (errno));
+        return path;
+    }
+
+    // Sets value from this child's variant when it names it
+    template <typename T>
+    bool Get (const std::string &name, T &value) const
+    {
+        if (!IsChild ())
+            return false;
+        for (const std::pair<std::string, std::string> &entry : m_variants[m_variant])
+        {
+            if (entry.first != name)
+                continue;
+            std::istringstream in (entry.second);
+            return static_cast<bool> (in >> value);
+        }
+        return false;
+    }
+
+    // Applies this child's variant to queue. stream is the disc's fixed
+    // random stream, re-created under the new run number.
+    void Apply (Ptr<QueueDisc> queue, int64_t stream) const
+    {
+        if (!IsChild ())
+            return;
+        Ptr<RedQueueDisc> red = DynamicCast<RedQueueDisc> (queue);
+        for (const std::pair<std::string, std::string> &entry : m_variants[m_variant])
+        {
+            const std::string &name = entry.first;
+            if (name == "runNumber")
+            {
+                Ptr<PieQueueDisc> pie = DynamicCast<PieQueueDisc> (queue);
+                if (red)
+                    red->AssignStreams (stream);
+                else if (pie)
+                    pie->AssignStreams (stream);
+                continue;
+            }
+            if (name == "qw")
+            {
+                if (red)
+                    red->SetAttribute ("QW", StringValue (entry.second));
+                continue;
+            }
+            NS_ABORT_MSG_IF (red && IsRedInitParameter (name),
+                             "RED's " << name << " is fixed when the disc is initialised, it cannot vary after the fork");
+            TypeId::AttributeInformation info;
+            if (queue->GetInstanceTypeId ().LookupAttributeByName (name, &info))
+                queue->SetAttribute (name, StringValue (entry.second));
+        }
+    }
+
+    void Report (RunSummary &summary) const
+    {
+        summary.Add ("variant", m_variant);
+        summary.Add ("warmup", m_warmup);
+    }
+
+private:
+    enum Role
+    {
+        SINGLE,
+        PARENT,
+        CHILD
+    };
+
+    static bool IsRedInitParameter (const std::string &name)
+    {
+        return name == "MinTh" || name == "MaxTh" || name == "LInterm" || name == "QueueLimit" || name == "MeanPktSize"
+               || name == "LinkBandwidth" || name == "LinkDelay" || name == "ARED" || name == "Gentle"
+               || name == "Mode";
+    }
+
+    static std::string Trim (const std::string &s)
+    {
+        size_t b = s.find_first_not_of (" \t\r");
+        if (b == std::string::npos)
+            return "";
+        return s.substr (b, s.find_last_not_of (" \t\r") - b + 1);
+    }
+
+    static void Split (const std::string &s, char sep, std::vector<std::string> &out)
+    {
+        std::istringstream in (s);
+        std::string item;
+        while (std::getline (in, item, sep))
+            out.push_back (item);
+    }
+
+    void Fork ()
+    {
+        // Anything still buffered would be written once by every child
+        std::cout.flush ();
+        std::fflush (nullptr);
+
+        uint32_t running = 0;
+        for (uint32_t i = 0; i < m_variants.size (); ++i)
+        {
+            if (m_jobs > 0 && running >= m_jobs)
+            {
+                Reap ();
+                running--;
+            }
+            pid_t pid = fork ();
+            NS_ABORT_MSG_IF (pid < 0, "fork failed for variant " << i);
+            if (pid == 0)
+            {
+                m_role = CHILD;
+                m_variant = i;
+                uint32_t run;
+                if (Get ("runNumber", run))
+                    SeedManager::SetRun (run);
+                m_enter (i);
+                return;
+            }
+            running++;
+        }
+        while (running-- > 0)
+            Reap ();
+
+        m_role = PARENT;
+        std::cout << "\tForked\t" << m_variants.size () << "\tvariants at\t" << m_warmup << " s\tfailed\t" << m_failed
+                  << std::endl;
+        Simulator::Stop ();
+    }
+
+    void Reap ()
+    {
+        int status = 0;
+        if (wait (&status) < 0 || !WIFEXITED (status) || WEXITSTATUS (status) != 0)
+            m_failed++;
+    }
+
+    std::vector<Variant> m_variants;
+    double m_warmup;
+    uint32_t m_jobs;
+    Enter m_enter;
+    Role m_role;
+    uint32_t m_variant;
+    uint32_t m_failed;
+};
+
+} // namespace ns3
+
+#endif /* RED_FORK_H */
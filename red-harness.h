@@ -0,0 +1,459 @@
+/** Everything a RED program does besides building its topology
+ *
+ * p2a, p2b, p2c and red-scenario used to carry their own copy of the
+ * shared options, their checks, the trace and instrumentation setup, the
+ * --forkVariants hook and the summary. A RedHarness holds all of it, so a
+ * program only builds nodes, links and applications:
+ *
+ *   RedHarness harness ("P2a");
+ *   harness.AddValues (cmd);           // then the program's own options
+ *   cmd.Parse (argc, argv);
+ *   harness.Configure ();              // checks the options, parses --forkVariants
+ *   harness.ApplyDefaults (packetSize);
+ *   cmd.Parse (argc, argv);            // again, for the --ns3::... attributes
+ *   ...nodes, links, harness.monitor.Add (queue, name), sources, sinks...
+ *   harness.Start (sinks, arriveColumns, dropColumns);
+ *   if (!harness.Run ())
+ *       return harness.GetForkStatus ();  // a --forkVariants parent
+ *   harness.Finish ();
+ *   RunSummary summary; harness.Report (summary); harness.WriteSummary (summary);
+ *   harness.Close ();
+ *
+ * p2c calls UseMpi () between Configure () and ApplyDefaults () to split
+ * across MPI ranks (red-mpi.h). The instrumentation, the workload and the
+ * size mix are public members: the programs install sources through
+ * workload and sizeMix and hand their queues to monitor.
+ */
+
+#ifndef RED_HARNESS_H
+#define RED_HARNESS_H
+
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <string>
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/flow-monitor-helper.h"
+#include "ns3/point-to-point-module.h"
+#include "ns3/applications-module.h"
+#include "ns3/traffic-control-module.h"
+
+#include "red-async-writer.h"
+#include "red-common.h"
+#include "red-flight-recorder.h"
+#include "red-flow-table.h"
+#include "red-fork.h"
+#include "red-link-monitor.h"
+#include "red-mpi.h"
+#include "red-profile.h"
+#include "red-queue-monitor.h"
+#include "red-run-summary.h"
+#include "red-size-mix.h"
+#include "red-telemetry.h"
+#include "red-workload.h"
+
+namespace ns3 {
+
+class RedHarness
+{
+public:
+    explicit RedHarness (const std::string &defaultPathOut)
+      : pathOut (defaultPathOut),
+        runNumber (0),
+        stopTime (1.0),
+        startJitter (0),
+        monitor (traceOut),
+        m_writeForPlot (true),
+        m_writePcap (false),
+        m_flowMonitor (false),
+        m_traceFormat ("text"),
+        m_exportText (false),
+        m_asyncTrace (true),
+        m_traceBackpressure ("block"),
+        m_occupancyMode ("poll"),
+        m_occupancyTolerance (0),
+        m_writeFlowTable (false),
+        m_flowBin (0.1),
+        m_sojourn (false),
+        m_sojournWindow (0.1),
+        m_sojournPerFlow (false),
+        m_profile (false),
+        m_writeSummary (false),
+        m_warmup (0.3),
+        m_forkJobs (0),
+        m_telemetryInterval (0.1),
+        m_plot (true),
+        m_trackSojourn (false),
+        m_format (TraceFileWriter::TEXT),
+        m_backpressure (AsyncTraceWriter::BLOCK),
+        m_mpi (false),
+        m_rank (0),
+        m_ranks (1),
+        m_rxAtFork (0),
+        m_totalBytes (0),
+        m_runSeconds (0)
+    {
+    }
+
+    // Registers the options every program shares; set the defaults of red,
+    // pathOut and stopTime first
+    void AddValues (CommandLine &cmd)
+    {
+        cmd.AddValue ("runNumber", "run number for random variable generation", runNumber);
+        cmd.AddValue ("pathOut", "Path to save results from --writeForPlot/--writePcap/--writeFlowMonitor/--writeSummary", pathOut);
+        cmd.AddValue ("maxPackets", "Max packets allowed in the RED queues", red.queueLimit);
+        cmd.AddValue ("writeForPlot", "<0/1> to write results for plot (gnuplot)", m_writeForPlot);
+        cmd.AddValue ("writePcap", "<0/1> to write results in pcapfile", m_writePcap);
+        cmd.AddValue ("writeFlowMonitor", "<0/1> to enable Flow Monitor and write their results", m_flowMonitor);
+        cmd.AddValue ("traceFormat", "<text/binary/columnar> format of the --writeForPlot traces", m_traceFormat);
+        cmd.AddValue ("exportText", "<0/1> convert binary/columnar traces to .plot text files at the end of the run", m_exportText);
+        cmd.AddValue ("asyncTrace", "<0/1> format and write traces on a background I/O thread", m_asyncTrace);
+        cmd.AddValue ("traceBackpressure", "<block/drop> what to do when the trace ring is full", m_traceBackpressure);
+        cmd.AddValue ("occupancy", "<poll/event> sample the queues every 10 ms or follow every change exactly", m_occupancyMode);
+        cmd.AddValue ("occupancyTolerance", "Packets (of --meanPktSize bytes with --byteMode) the --occupancy=event timelines may be off by (0 writes every change)", m_occupancyTolerance);
+        cmd.AddValue ("writeFlowTable", "<0/1> write per-flow bytes and fairness per time bin to <pathOut>/flows.txt", m_writeFlowTable);
+        cmd.AddValue ("flowBin", "Bin width of the --writeFlowTable table (seconds)", m_flowBin);
+        cmd.AddValue ("sojourn", "<0/1> measure every packet's queueing delay, written to <pathOut>/sojourn.txt", m_sojourn);
+        cmd.AddValue ("sojournWindow", "Window of the per-window --sojourn quantiles (seconds)", m_sojournWindow);
+        cmd.AddValue ("sojournPerFlow", "<0/1> also keep a --sojourn delay histogram per flow", m_sojournPerFlow);
+        cmd.AddValue ("profile", "<0/1> count events and time the trace callbacks, reported with --writeSummary", m_profile);
+        red.AddValues (cmd);
+        cmd.AddValue ("stopTime", "Simulation stop time (seconds)", stopTime);
+        cmd.AddValue ("startJitter", "Random extra start delay of every source, up to this many seconds", startJitter);
+        cmd.AddValue ("forkVariants", "Variants forked from one --warmup, e.g. \"qw=0.002;qw=0.02,runNumber=2\" or @file (see red-fork.h)", m_forkVariants);
+        cmd.AddValue ("warmup", "Seconds simulated once before the --forkVariants children split off", m_warmup);
+        cmd.AddValue ("forkJobs", "--forkVariants children running at a time (0 = all)", m_forkJobs);
+        recorder.AddValues (cmd);
+        links.AddValues (cmd);
+        sizeMix.AddValues (cmd);
+        workload.AddValues (cmd);
+        cmd.AddValue ("telemetry", "Stream live queue and sink snapshots on this localhost TCP port or Unix socket path", m_telemetryAddress);
+        cmd.AddValue ("telemetryInterval", "Simulated seconds between --telemetry snapshots", m_telemetryInterval);
+        cmd.AddValue ("writeSummary", "<0/1> write end-of-run aggregates to <pathOut>/summary.txt", m_writeSummary);
+    }
+
+    // Checks the options and reads the size file, the workload and the
+    // fork variants; call after the first cmd.Parse ()
+    void Configure ()
+    {
+        NS_ABORT_MSG_UNLESS (m_occupancyMode == "poll" || m_occupancyMode == "event", "--occupancy must be poll or event");
+        NS_ABORT_MSG_UNLESS (TraceFileWriter::ParseFormat (m_traceFormat, m_format),
+                             "--traceFormat must be text, binary or columnar");
+        NS_ABORT_MSG_UNLESS (AsyncTraceWriter::ParseBackpressure (m_traceBackpressure, m_backpressure),
+                             "--traceBackpressure must be block or drop");
+        // The ring replaces the full per-packet traces
+        m_plot = m_writeForPlot && !recorder.IsEnabled ();
+        std::string error;
+        NS_ABORT_MSG_UNLESS (sizeMix.Load (error), error);
+        NS_ABORT_MSG_UNLESS (workload.Parse (red.linkRate, error), error);
+        // The size classes' delays come from the sojourn stamps
+        m_trackSojourn = m_sojourn || !sizeMix.GetSizeClasses ().empty ();
+
+        if (m_forkVariants.empty ())
+            return;
+        NS_ABORT_MSG_UNLESS (warmFork.Parse (m_forkVariants, error), error);
+        NS_ABORT_MSG_IF (m_writePcap || m_writeFlowTable || links.IsEnabled () || workload.IsWritingFct (),
+                         "--forkVariants children cannot share the --writePcap/--writeFlowTable/--writeLinks/--writeFct files");
+        NS_ABORT_MSG_UNLESS (m_warmup > 0 && m_warmup < stopTime, "--warmup must lie inside the run");
+        NS_ABORT_MSG_UNLESS (m_telemetryAddress.empty (), "--telemetry runs a thread, which cannot be forked");
+        // Every child would append to the parent's trace files
+        m_plot = false;
+    }
+
+    // Runs the simulation on the MPI ranks; call after Configure () and
+    // before any node is created
+    void UseMpi (int *argc, char ***argv)
+    {
+        NS_ABORT_MSG_IF (warmFork.IsEnabled () || !m_telemetryAddress.empty () || recorder.IsEnabled (),
+                         "--mpi runs cannot fork, stream telemetry or record dumps");
+        NS_ABORT_MSG_IF (m_writePcap || m_writeFlowTable || m_flowMonitor || links.IsEnabled (),
+                         "--mpi ranks cannot share the --writePcap/--writeFlowTable/--writeFlowMonitor/--writeLinks files");
+        NS_ABORT_MSG_IF (workload.GetSpec ().HasFlows (),
+                         "--mpi ranks cannot match a --workload flow sent on one rank to its sink on the other");
+        EnableMpi (argc, argv);
+        m_mpi = true;
+        m_rank = GetMpiRank ();
+        m_ranks = GetMpiSize ();
+    }
+
+    // Profiling, the run's seed and the TCP and RED defaults. Parse the
+    // command line again afterwards, so that --ns3::RedQueueDisc::... and
+    // --ns3::TcpSocket::... attribute overrides win over these defaults.
+    void ApplyDefaults (uint32_t packetSize)
+    {
+        if (m_profile)
+            EnableProfiling ();
+
+        SeedManager::SetSeed (1);
+        SeedManager::SetRun (runNumber);
+
+        ApplyTcpDefaults (packetSize);
+        ApplyRedDefaults (red);
+        if (red.ecn)
+            monitor.CountMarks ();
+        monitor.SetEwmaWeight (red.qw);
+        monitor.SetSizeClasses (sizeMix.GetSizeClasses ());
+    }
+
+    // Opens the outputs, hooks the instrumentation into the monitored
+    // queues and sinks and schedules the fork; call once the topology,
+    // the addresses and the applications are in place. arriveColumns and
+    // dropColumns pick the PacketNum/PacketDrop columns.
+    void Start (const ApplicationContainer &sinks, uint32_t arriveColumns, uint32_t dropColumns)
+    {
+        m_sinks = sinks;
+        NS_ABORT_MSG_UNLESS (workload.Watch (m_sinks, pathOut), "cannot write " << pathOut << "/fct.txt");
+
+        // One table for every monitored queue, the 5-tuple tells the directions apart
+        if (m_writeFlowTable)
+        {
+            flowTable.Open (pathOut + "/flows.txt", m_flowBin);
+            for (uint32_t i = 0; i < monitor.GetN (); ++i)
+                flowTable.Connect (monitor.Get (i).queue);
+        }
+
+        if (m_writePcap)
+        {
+            PointToPointHelper ptp;
+            ptp.EnablePcapAll (pathOut + "/red");
+        }
+
+        if (m_flowMonitor)
+        {
+            FlowMonitorHelper flowmonHelper;
+            m_flowmon = flowmonHelper.InstallAll ();
+        }
+
+        if (m_plot)
+            monitor.OpenTraces (pathOut, m_format, arriveColumns, dropColumns);
+
+        // Every device has its root disc once the addresses are assigned
+        if (links.IsEnabled ())
+            NS_ABORT_MSG_UNLESS (links.Open (pathOut + "/links.txt"), "cannot write " << pathOut << "/links.txt");
+
+        if (recorder.IsEnabled ())
+        {
+            recorder.Open (pathOut, red.maxTh, red.GetQueueUnit ());
+            for (uint32_t i = 0; i < monitor.GetN (); ++i)
+                recorder.Connect (monitor.Get (i).queue, i);
+        }
+
+        // Tracked even without --writeForPlot, the statistics go into the summary
+        if (m_trackSojourn)
+            monitor.EnableSojourn (warmFork.IsEnabled () || m_mpi ? "" : pathOut + "/sojourn.txt", m_sojournWindow,
+                                   m_sojournPerFlow);
+        monitor.Start (m_occupancyMode == "event", m_occupancyTolerance);
+
+        if (!m_telemetryAddress.empty ())
+        {
+            std::string error;
+            NS_ABORT_MSG_UNLESS (telemetry.Open (m_telemetryAddress, error), error);
+            telemetry.Start (monitor, m_sinks, Seconds (m_telemetryInterval));
+        }
+
+        if (m_plot && m_asyncTrace)
+        {
+            traceOut.SetBackpressure (m_backpressure);
+            traceOut.Start ();
+        }
+
+        // Each child measures from the warm-up on, into its own directory
+        if (warmFork.IsEnabled ())
+            warmFork.Schedule (m_warmup, m_forkJobs, [this] (uint32_t) {
+                pathOut = warmFork.MakeChildPath (pathOut);
+                recorder.SetPath (pathOut);
+                m_rxAtFork = SumSinkBytes (m_sinks);
+                monitor.Restart ();
+                workload.Restart ();
+                for (uint32_t i = 0; i < monitor.GetN (); ++i)
+                    warmFork.Apply (monitor.Get (i).queue, i);
+                warmFork.Get ("runNumber", runNumber);
+                // The monitor's average follows the variant's weight, like the disc's
+                if (warmFork.Get ("qw", red.qw))
+                    monitor.SetEwmaWeight (red.qw);
+            });
+    }
+
+    // Runs the simulation to stopTime. Returns false in a --forkVariants
+    // parent, which only ran the warm-up while the children wrote the
+    // results; it has destroyed the simulator and exits with
+    // GetForkStatus ().
+    bool Run ()
+    {
+        Simulator::Stop (Seconds (stopTime));
+        std::chrono::steady_clock::time_point runStart = std::chrono::steady_clock::now ();
+        Simulator::Run ();
+        m_runSeconds = SecondsSince (runStart);
+
+        if (!warmFork.IsParent ())
+            return true;
+        Simulator::Destroy ();
+        return false;
+    }
+
+    int GetForkStatus () const
+    {
+        return warmFork.GetFailed () > 0 ? 1 : 0;
+    }
+
+    // Closes the instrumentation and the traces and prints the bytes every
+    // sink received; returns their total
+    uint64_t Finish ()
+    {
+        telemetry.Stop ();
+        // A telemetry client may have ended the run early
+        if (telemetry.IsStoppedEarly ())
+            stopTime = Simulator::Now ().GetSeconds ();
+
+        monitor.Finish (stopTime);
+        flowTable.Finish (stopTime);
+        links.Finish (stopTime);
+        workload.Finish (stopTime);
+
+        // Every trace record must be on disk before the simulator is torn down
+        traceOut.Stop ();
+        monitor.CloseTraces (m_plot && m_exportText);
+        if (traceOut.GetLost () > 0)
+            std::cout << "\tTrace records lost to backpressure\t" << traceOut.GetLost () << std::endl;
+        if (monitor.GetTraceLost () > 0)
+            std::cout << "\tTrace records lost to failed writes\t" << monitor.GetTraceLost () << std::endl;
+
+        m_totalBytes = ReportSinkTotals (m_sinks);
+        return m_totalBytes;
+    }
+
+    bool IsWritingSummary () const
+    {
+        return m_writeSummary;
+    }
+
+    // The run's parameters, throughput, memory and profile, and what every
+    // piece of instrumentation measured
+    void Report (RunSummary &summary) const
+    {
+        summary.Add ("runNumber", runNumber);
+        summary.Add ("minTh", red.minTh);
+        summary.Add ("maxTh", red.maxTh);
+        summary.Add ("qw", red.qw);
+        summary.Add ("queueLimit", red.queueLimit);
+        summary.Add ("ecn", red.ecn);
+        summary.Add ("byteMode", red.byteMode);
+        summary.Add ("stopTime", stopTime);
+        summary.Add ("startJitter", startJitter);
+        if (warmFork.IsChild ())
+            warmFork.Report (summary);
+        summary.Add ("totalRx", m_totalBytes);
+        summary.Add ("throughputMbps",
+                     (m_totalBytes - m_rxAtFork) * 8.0 / (stopTime - warmFork.GetMeasureStart ()) / 1e6);
+        summary.Add ("peakRssBytes", GetPeakResidentBytes ());
+        ReportProfile (summary, m_runSeconds);
+        monitor.Report (summary, stopTime);
+        if (recorder.IsEnabled ())
+            recorder.Report (summary);
+        if (links.IsEnabled ())
+            links.Report (summary);
+        if (sizeMix.IsEnabled ())
+            sizeMix.Report (summary);
+        workload.Report (summary);
+        if (!m_telemetryAddress.empty ())
+            telemetry.Report (summary);
+        if (m_plot)
+        {
+            summary.Add ("traceLost", traceOut.GetLost ());
+            summary.Add ("traceWriteLost", monitor.GetTraceLost ());
+        }
+        if (m_writeFlowTable)
+        {
+            summary.Add ("trackedFlows", flowTable.GetFlowCount ());
+            summary.Add ("jainIndex", flowTable.GetJainIndex ());
+        }
+    }
+
+    // Writes <pathOut>/summary.txt; under MPI every rank writes its own and
+    // rank 0 merges them once all are written
+    void WriteSummary (const RunSummary &summary) const
+    {
+        if (!m_mpi)
+        {
+            summary.Write (pathOut + "/summary.txt");
+            return;
+        }
+        summary.Write (GetRankSummaryPath (pathOut, m_rank));
+        MpiBarrier ();
+        if (m_rank == 0)
+            NS_ABORT_MSG_UNLESS (MergeRankSummaries (pathOut, m_ranks), "cannot merge the rank summaries in " << pathOut);
+    }
+
+    // Writes the flow monitor and tears the simulator down
+    void Close ()
+    {
+        std::cout << "Done" << std::endl;
+
+        if (m_flowMonitor)
+            m_flowmon->SerializeToXmlFile (pathOut + "/red.flowmon", false, false);
+
+        Simulator::Destroy ();
+        if (m_mpi)
+            DisableMpi ();
+    }
+
+    RedParams red;
+    std::string pathOut;
+    uint32_t runNumber;
+    double stopTime;
+    double startJitter;
+
+    AsyncTraceWriter traceOut;
+    QueueMonitor monitor;
+    FlowTable flowTable;
+    FlightRecorder recorder;
+    LinkMonitor links;
+    SizeMix sizeMix;
+    Workload workload;
+    QueueTelemetry telemetry;
+    WarmFork warmFork;
+
+private:
+    bool m_writeForPlot;
+    bool m_writePcap;
+    bool m_flowMonitor;
+    std::string m_traceFormat;
+    bool m_exportText;
+    bool m_asyncTrace;
+    std::string m_traceBackpressure;
+    std::string m_occupancyMode;
+    uint32_t m_occupancyTolerance;
+    bool m_writeFlowTable;
+    double m_flowBin;
+    bool m_sojourn;
+    double m_sojournWindow;
+    bool m_sojournPerFlow;
+    bool m_profile;
+    bool m_writeSummary;
+    std::string m_forkVariants;
+    double m_warmup;
+    uint32_t m_forkJobs;
+    std::string m_telemetryAddress;
+    double m_telemetryInterval;
+
+    // What Configure () made of the options; a second cmd.Parse () leaves
+    // them alone
+    bool m_plot;
+    bool m_trackSojourn;
+    TraceFileWriter::Format m_format;
+    AsyncTraceWriter::Backpressure m_backpressure;
+    bool m_mpi;
+    uint32_t m_rank;
+    uint32_t m_ranks;
+    ApplicationContainer m_sinks;
+    Ptr<FlowMonitor> m_flowmon;
+    uint64_t m_rxAtFork;
+    uint64_t m_totalBytes;
+    double m_runSeconds;
+};
+
+} // namespace ns3
+
+#endif /* RED_HARNESS_H */
@@ -0,0 +1,259 @@
+/** Utilization and backlog of every point-to-point link
+ *
+ * The QueueMonitor only watches the queues a program names. A LinkMonitor
+ * watches every PointToPointNetDevice in the simulation, so the saturated
+ * link of a bigger topology shows up without knowing it beforehand. Per
+ * packet it only adds the size to its device's counter (PhyTxEnd); the
+ * backlog, the packets in the device's root queue disc plus those in the
+ * device queue, is polled --linkSamples times per bin by one event for all
+ * devices.
+ *
+ * Time is cut into --linkBin bins, written to <pathOut>/links.txt:
+ *   W <binWidth>                             first line
+ *   L <id> <from> <to> <bps>                 once per device
+ *   U <binStart> <util_0> ... <util_n-1>     busy fraction of each link
+ *   Q <binStart> <backlog_0> ...             mean backlog (packets)
+ *   T <rank> <id> <util> <backlog>           top-k over the run, at the end
+ * plotlinks.py draws both as heatmaps. The --topLinks most utilised links
+ * (ties broken by backlog) are also printed and go into summary.txt.
+ */
+
+#ifndef RED_LINK_MONITOR_H
+#define RED_LINK_MONITOR_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/point-to-point-module.h"
+#include "ns3/traffic-control-module.h"
+
+#include "red-profile.h"
+#include "red-run-summary.h"
+
+namespace ns3 {
+
+class LinkMonitor
+{
+public:
+    LinkMonitor ()
+      : m_enabled (false),
+        m_binWidth (0.1),
+        m_samples (10),
+        m_top (5),
+        m_file (nullptr),
+        m_binStart (0),
+        m_sample (0),
+        m_bins (0)
+    {
+    }
+
+    ~LinkMonitor ()
+    {
+        if (m_file)
+            std::fclose (m_file);
+    }
+
+    void AddValues (CommandLine &cmd)
+    {
+        cmd.AddValue ("writeLinks", "<0/1> write utilization and backlog of every link per bin to <pathOut>/links.txt", m_enabled);
+        cmd.AddValue ("linkBin", "Bin width of the --writeLinks heatmap (seconds)", m_binWidth);
+        cmd.AddValue ("linkSamples", "Backlog samples per --linkBin", m_samples);
+        cmd.AddValue ("topLinks", "Most utilised links reported at the end of a --writeLinks run", m_top);
+    }
+
+    bool IsEnabled () const
+    {
+        return m_enabled;
+    }
+
+    // Watches every point-to-point device that exists now; call once the
+    // queue discs are installed
+    bool Open (const std::string &path)
+    {
+        m_file = std::fopen (path.c_str (), "w");
+        if (!m_file)
+            return false;
+        for (NodeList::Iterator it = NodeList::Begin (); it != NodeList::End (); ++it)
+        {
+            Ptr<Node> node = *it;
+            Ptr<TrafficControlLayer> tc = node->GetObject<TrafficControlLayer> ();
+            for (uint32_t d = 0; d < node->GetNDevices (); ++d)
+            {
+                Ptr<PointToPointNetDevice> dev = DynamicCast<PointToPointNetDevice> (node->GetDevice (d));
+                if (!dev)
+                    continue;
+                Link link;
+                link.device = dev;
+                link.queue = dev->GetQueue ();
+                if (tc)
+                    link.disc = tc->GetRootQueueDiscOnDevice (dev);
+                DataRateValue rate;
+                dev->GetAttribute ("DataRate", rate);
+                link.bps = rate.Get ().GetBitRate ();
+                link.from = NameOf (node);
+                link.to = "?";
+                Ptr<Channel> channel = dev->GetChannel ();
+                for (uint32_t i = 0; channel && i < channel->GetNDevices (); ++i)
+                    if (channel->GetDevice (i) != dev)
+                        link.to = NameOf (channel->GetDevice (i)->GetNode ());
+                link.bytes = 0;
+                link.backlog = 0;
+                link.totalBytes = 0;
+                link.totalBacklog = 0;
+                dev->TraceConnectWithoutContext ("PhyTxEnd", MakeBoundCallback (&LinkMonitor::Sent, this,
+                                                                                 static_cast<uint32_t> (m_links.size ())));
+                m_links.push_back (link);
+            }
+        }
+
+        std::fprintf (m_file, "W %g\n", m_binWidth);
+        for (size_t i = 0; i < m_links.size (); ++i)
+            std::fprintf (m_file, "L %u %s %s %.17g\n", static_cast<uint32_t> (i), m_links[i].from.c_str (),
+                          m_links[i].to.c_str (), m_links[i].bps);
+        Simulator::Schedule (Seconds (m_binWidth / m_samples), &LinkMonitor::Sample, this);
+        return true;
+    }
+
+    // Writes the bin in progress and the top-k report, and closes the file
+    void Finish (double stopTime)
+    {
+        if (!m_file)
+            return;
+        if (m_sample > 0)
+            CloseBin (stopTime - m_binStart);
+        Rank (stopTime);
+        for (size_t r = 0; r < m_ranked.size (); ++r)
+        {
+            const Ranked &k = m_ranked[r];
+            std::fprintf (m_file, "T %u %u %.6g %.6g\n", static_cast<uint32_t> (r + 1), k.id, k.util, k.backlog);
+            std::cout << "\tLink\t" << m_links[k.id].from << "->" << m_links[k.id].to << "\tutilization\t" << k.util
+                      << "\tbacklog\t" << k.backlog << std::endl;
+        }
+        std::fclose (m_file);
+        m_file = nullptr;
+    }
+
+    // topLink<r>Id, topLink<r>Util and topLink<r>Backlog of the Finish ranking
+    void Report (RunSummary &summary) const
+    {
+        summary.Add ("links", m_links.size ());
+        for (size_t r = 0; r < m_ranked.size (); ++r)
+        {
+            std::string prefix = "topLink" + std::to_string (r + 1);
+            summary.Add (prefix + "Id", m_ranked[r].id);
+            summary.Add (prefix + "Util", m_ranked[r].util);
+            summary.Add (prefix + "Backlog", m_ranked[r].backlog);
+        }
+    }
+
+private:
+    struct Link
+    {
+        Ptr<PointToPointNetDevice> device;
+        Ptr<Queue<Packet> > queue;
+        Ptr<QueueDisc> disc;
+        double bps;
+        std::string from;
+        std::string to;
+        uint64_t bytes;        // this bin
+        double backlog;        // sum of this bin's samples
+        uint64_t totalBytes;
+        double totalBacklog;   // sum of the bins' mean backlogs
+    };
+
+    struct Ranked
+    {
+        uint32_t id;
+        double util;
+        double backlog;
+    };
+
+    static CallbackTimer &Timer ()
+    {
+        static CallbackTimer timer ("Links");
+        return timer;
+    }
+
+    static std::string NameOf (Ptr<Node> node)
+    {
+        std::string name = Names::FindName (node);
+        return name.empty () ? "n" + std::to_string (node->GetId ()) : name;
+    }
+
+    static void Sent (LinkMonitor *monitor, uint32_t id, Ptr<const Packet> packet)
+    {
+        TimedScope timed (Timer ());
+        monitor->m_links[id].bytes += packet->GetSize ();
+    }
+
+    void Sample ()
+    {
+        for (Link &link : m_links)
+            link.backlog += (link.disc ? link.disc->GetNPackets () : 0) + (link.queue ? link.queue->GetNPackets () : 0);
+        if (++m_sample == m_samples)
+            CloseBin (m_binWidth);
+        Simulator::Schedule (Seconds (m_binWidth / m_samples), &LinkMonitor::Sample, this);
+    }
+
+    void CloseBin (double width)
+    {
+        std::fprintf (m_file, "U %.9g", m_binStart);
+        for (const Link &link : m_links)
+            std::fprintf (m_file, " %.4f", link.bytes * 8.0 / (link.bps * width));
+        std::fprintf (m_file, "\nQ %.9g", m_binStart);
+        for (Link &link : m_links)
+        {
+            double backlog = link.backlog / m_sample;
+            std::fprintf (m_file, " %.4g", backlog);
+            link.totalBytes += link.bytes;
+            link.totalBacklog += backlog;
+            link.bytes = 0;
+            link.backlog = 0;
+        }
+        std::fprintf (m_file, "\n");
+        m_binStart += width;
+        m_sample = 0;
+        m_bins++;
+    }
+
+    void Rank (double stopTime)
+    {
+        m_ranked.clear ();
+        for (size_t i = 0; i < m_links.size (); ++i)
+        {
+            const Link &link = m_links[i];
+            Ranked k;
+            k.id = i;
+            k.util = stopTime > 0 ? link.totalBytes * 8.0 / (link.bps * stopTime) : 0.0;
+            k.backlog = m_bins > 0 ? link.totalBacklog / m_bins : 0.0;
+            m_ranked.push_back (k);
+        }
+        size_t k = std::min<size_t> (m_top, m_ranked.size ());
+        std::partial_sort (m_ranked.begin (), m_ranked.begin () + k, m_ranked.end (),
+                           [] (const Ranked &a, const Ranked &b) {
+                               return a.util != b.util ? a.util > b.util : a.backlog > b.backlog;
+                           });
+        m_ranked.resize (k);
+    }
+
+    bool m_enabled;
+    double m_binWidth;
+    uint32_t m_samples;
+    uint32_t m_top;
+    FILE *m_file;
+    std::vector<Link> m_links;
+    std::vector<Ranked> m_ranked;
+    double m_binStart;
+    uint32_t m_sample;
+    uint32_t m_bins;
+};
+
+} // namespace ns3
+
+#endif /* RED_LINK_MONITOR_H */
@@ -0,0 +1,202 @@
+/** Running a scenario on several MPI ranks
+ *
+ * The dumbbells split naturally at the bottleneck: NA with its edge nodes
+ * on one rank, NB with its edge nodes on another. Only the bottleneck link
+ * crosses ranks, and ns-3's PointToPointHelper turns it into a remote
+ * channel by itself when its two nodes carry different system ids. Its
+ * delay (--linkDelay, 2 ms by default) is the lookahead of the
+ * conservative DistributedSimulatorImpl, so the ranks synchronise once per
+ * 2 ms of simulated time rather than once per packet.
+ *
+ * Every rank builds the whole topology, so node ids, addresses, routes
+ * and the random streams of the queue discs are those of the serial run;
+ * applications, the monitor and the traces are only installed where their
+ * node lives. Each rank writes <pathOut>/summary-rank<N>.txt and rank 0
+ * merges them into summary.txt (MergeRankSummaries), which needs pathOut
+ * on a shared file system when the ranks are on different hosts.
+ *
+ * Needs ns-3 configured with --enable-mpi, and a run through mpirun:
+ *   mpirun -np 2 ./waf --run "p2c --mpi=1 --writeSummary=1"
+ */
+
+#ifndef RED_MPI_H
+#define RED_MPI_H
+
+#include <algorithm>
+#include <cstdio>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+
+#ifdef NS3_MPI
+#include <mpi.h>
+#include "ns3/mpi-interface.h"
+#endif
+
+#include "red-run-summary.h"
+
+namespace ns3 {
+
+// Call after cmd.Parse (), before any node is created
+inline void
+EnableMpi (int *argc, char ***argv)
+{
+#ifdef NS3_MPI
+    GlobalValue::Bind ("SimulatorImplementationType", StringValue ("ns3::DistributedSimulatorImpl"));
+    MpiInterface::Enable (argc, argv);
+#else
+    NS_FATAL_ERROR ("--mpi needs ns-3 configured with --enable-mpi");
+#endif
+}
+
+inline void
+DisableMpi ()
+{
+#ifdef NS3_MPI
+    MpiInterface::Disable ();
+#endif
+}
+
+inline uint32_t
+GetMpiRank ()
+{
+#ifdef NS3_MPI
+    return MpiInterface::IsEnabled () ? MpiInterface::GetSystemId () : 0;
+#else
+    return 0;
+#endif
+}
+
+inline uint32_t
+GetMpiSize ()
+{
+#ifdef NS3_MPI
+    return MpiInterface::IsEnabled () ? MpiInterface::GetSize () : 1;
+#else
+    return 1;
+#endif
+}
+
+// Waits until every rank got here
+inline void
+MpiBarrier ()
+{
+#ifdef NS3_MPI
+    if (MpiInterface::IsEnabled ())
+        MPI_Barrier (MPI_COMM_WORLD);
+#endif
+}
+
+inline bool
+IsLocalNode (Ptr<Node> node)
+{
+    return node->GetSystemId () == GetMpiRank ();
+}
+
+inline std::string
+GetRankSummaryPath (const std::string &pathOut, uint32_t rank)
+{
+    char name[32];
+    std::snprintf (name, sizeof (name), "/summary-rank%u.txt", rank);
+    return pathOut + name;
+}
+
+inline bool
+IsSizeClassKey (const std::string &key, const std::string &suffix)
+{
+    return key.compare (0, 4, "size") == 0 && key.size () > 4 + suffix.size ()
+           && key.compare (key.size () - suffix.size (), suffix.size (), suffix) == 0;
+}
+
+// How MergeRankSummaries combines a key reported by several ranks: '+'
+// sums, 'm' averages, '>' keeps the largest, 'r' recomputes a size class's
+// drop rate from the merged counts, 'x' leaves the key out, '=' keeps the
+// first rank's value
+inline char
+GetMergeRule (const std::string &key)
+{
+    if (key == "totalRx" || key == "throughputMbps" || key == "flows" || key == "drops"
+        || key == "occupancyChanges" || key == "occupancyPoints" || key == "marks" || key == "ectArrivals"
+        || key == "mixSources" || key == "mixTxBytes" || key == "mixRxBytes")
+        return '+';
+    // The packet-size classes (red-size-mix.h): their counts add up, but
+    // their delay quantiles cannot be combined from the ranks' quantiles
+    if (IsSizeClassKey (key, "Arrivals") || IsSizeClassKey (key, "Drops"))
+        return '+';
+    if (IsSizeClassKey (key, "DropRate"))
+        return 'r';
+    if (IsSizeClassKey (key, "P50Ms") || IsSizeClassKey (key, "P99Ms"))
+        return 'x';
+    if (key == "meanQueue")
+        return 'm';
+    if (key == "peakRssBytes" || key == "runSeconds")
+        return '>';
+    return '=';
+}
+
+// Merges the ranks' summaries into <pathOut>/summary.txt. What the ranks
+// received and dropped adds up, the mean queue is averaged over the ranks
+// (one gate each), peak memory and run time are the slowest rank's, and
+// every other key, such as the per-gate statistics, comes from the first
+// rank that reported it. The size classes' delay quantiles stay in the
+// ranks' files only.
+inline bool
+MergeRankSummaries (const std::string &pathOut, uint32_t ranks)
+{
+    std::vector<std::string> keys;
+    std::map<std::string, double> values;
+    std::map<std::string, uint32_t> counts;
+    for (uint32_t rank = 0; rank < ranks; ++rank)
+    {
+        RunSummary part;
+        if (!part.Read (GetRankSummaryPath (pathOut, rank)))
+            return false;
+        for (const std::pair<std::string, double> &kv : part.GetValues ())
+        {
+            uint32_t &count = counts[kv.first];
+            double &value = values[kv.first];
+            if (count++ == 0)
+            {
+                keys.push_back (kv.first);
+                value = kv.second;
+                continue;
+            }
+            switch (GetMergeRule (kv.first))
+            {
+            case '+':
+                value += kv.second;
+                break;
+            case 'm':
+                value += (kv.second - value) / count;
+                break;
+            case '>':
+                value = std::max (value, kv.second);
+                break;
+            }
+        }
+    }
+
+    RunSummary merged;
+    for (const std::string &key : keys)
+    {
+        char rule = GetMergeRule (key);
+        if (rule == 'x')
+            continue;
+        if (rule == 'r')
+        {
+            std::string prefix = key.substr (0, key.size () - 8);
+            double arrivals = values[prefix + "Arrivals"];
+            values[key] = arrivals > 0 ? values[prefix + "Drops"] / arrivals : 0.0;
+        }
+        merged.Add (key, values[key]);
+    }
+    merged.Add ("ranks", ranks);
+    return merged.Write (pathOut + "/summary.txt");
+}
+
+} // namespace ns3
+
+#endif /* RED_MPI_H */
@@ -0,0 +1,212 @@
+/** Exact, event-driven queue occupancy
+ *
+ * The 10 ms samplers miss every transient shorter than their period and
+ * cost 100 events per simulated second per queue. OccupancyTracker instead
+ * follows the queue disc's own traces: +1 on Enqueue and Requeue, -1 on
+ * Dequeue and Drop. In ns-3.27 the Enqueue trace fires before DoEnqueue
+ * and an early or forced drop fires Drop afterwards, so the count matches
+ * QueueDisc::GetNPackets () at every instant without scheduling anything.
+ * With SetByteMode () it counts each item's size instead and matches
+ * GetNBytes (), the queue length byte-mode RED works with.
+ *
+ * Changes at the same timestamp are coalesced. Every resulting step goes
+ * to the QueueStats: its time average is exact, while its mean, variance
+ * and quantiles are then per change rather than per 10 ms tick, so only
+ * TimeAvg, Min and Max compare between the two modes. The change points
+ * handed to the sink can be thinned with a tolerance: a point is emitted
+ * only when the occupancy has moved more than that many packets (bytes in
+ * byte mode) away from the last emitted value. The step function rebuilt
+ * from the emitted points is then never off by more than the tolerance. A tolerance of 0
+ * emits every change.
+ */
+
+#ifndef RED_OCCUPANCY_H
+#define RED_OCCUPANCY_H
+
+#include <cstdint>
+#include <functional>
+
+#include "ns3/core-module.h"
+#include "ns3/traffic-control-module.h"
+
+#include "red-profile.h"
+#include "red-queue-stats.h"
+
+namespace ns3 {
+
+// Whether a disc's occupancy is in bytes: byte-mode RED's is
+inline bool
+CountsBytes (Ptr<QueueDisc> queue)
+{
+    Ptr<RedQueueDisc> red = DynamicCast<RedQueueDisc> (queue);
+    if (!red)
+        return false;
+    StringValue mode;
+    red->GetAttribute ("Mode", mode);
+    return mode.Get () == "QUEUE_DISC_MODE_BYTES";
+}
+
+// The one queue length every instrument reports: the disc's own packet
+// count, or its byte count when bytes is set. Inside an Enqueue trace it
+// already includes the arriving item, see ArrivalOccupancy ().
+inline uint32_t
+GetOccupancy (Ptr<const QueueDisc> queue, bool bytes)
+{
+    return bytes ? queue->GetNBytes () : queue->GetNPackets ();
+}
+
+// The length an arriving item finds, which is what RED averages; call from
+// the Enqueue trace
+inline uint32_t
+ArrivalOccupancy (Ptr<const QueueDisc> queue, bool bytes, Ptr<const QueueDiscItem> item)
+{
+    uint32_t length = GetOccupancy (queue, bytes);
+    uint32_t own = bytes ? item->GetSize () : 1;
+    return length > own ? length - own : 0;
+}
+
+class OccupancyTracker
+{
+public:
+    typedef std::function<void (double time, uint32_t occupancy)> Sink;
+
+    OccupancyTracker ()
+      : m_tolerance (0),
+        m_bytes (false),
+        m_stats (nullptr),
+        m_value (0),
+        m_pendingTime (0),
+        m_pending (false),
+        m_lastEmitted (0),
+        m_changes (0),
+        m_emitted (0)
+    {
+    }
+
+    // Largest error, in packets or bytes, allowed in the emitted timeline
+    void SetTolerance (uint32_t tolerance)
+    {
+        m_tolerance = tolerance;
+    }
+
+    // Counts bytes rather than packets; call before Connect ()
+    void SetByteMode (bool bytes)
+    {
+        m_bytes = bytes;
+    }
+
+    // Receives every coalesced step
+    void SetStats (QueueStats *stats)
+    {
+        m_stats = stats;
+    }
+
+    // Receives the change points that pass the tolerance
+    void SetSink (Sink sink)
+    {
+        m_sink = sink;
+    }
+
+    // Hooks the queue disc traces and records the current state; set the
+    // stats and sink first
+    void Connect (Ptr<QueueDisc> queue)
+    {
+        queue->TraceConnectWithoutContext ("Enqueue", MakeCallback (&OccupancyTracker::Added, this));
+        queue->TraceConnectWithoutContext ("Requeue", MakeCallback (&OccupancyTracker::Added, this));
+        queue->TraceConnectWithoutContext ("Dequeue", MakeCallback (&OccupancyTracker::Removed, this));
+        queue->TraceConnectWithoutContext ("Drop", MakeCallback (&OccupancyTracker::Removed, this));
+
+        double now = Simulator::Now ().GetSeconds ();
+        m_value = GetOccupancy (queue, m_bytes);
+        if (m_stats)
+            m_stats->Sample (now, m_value);
+        Emit (now, m_value);
+    }
+
+    void Change (double time, int32_t delta)
+    {
+        if (m_pending && time != m_pendingTime)
+            Flush ();
+        m_value += delta;
+        m_pendingTime = time;
+        m_pending = true;
+        m_changes++;
+    }
+
+    // Flushes the pending step and emits the final value at time
+    void Finish (double time)
+    {
+        if (m_pending)
+            Flush ();
+        if (m_sink)
+            m_sink (time, m_value);
+        m_emitted++;
+    }
+
+    uint32_t Get () const
+    {
+        return m_value;
+    }
+
+    uint64_t GetChanges () const
+    {
+        return m_changes;
+    }
+
+    uint64_t GetEmitted () const
+    {
+        return m_emitted;
+    }
+
+private:
+    static CallbackTimer &Timer ()
+    {
+        static CallbackTimer timer ("Occupancy");
+        return timer;
+    }
+
+    void Added (Ptr<const QueueDiscItem> item)
+    {
+        TimedScope timed (Timer ());
+        Change (Simulator::Now ().GetSeconds (), m_bytes ? static_cast<int32_t> (item->GetSize ()) : 1);
+    }
+
+    void Removed (Ptr<const QueueDiscItem> item)
+    {
+        TimedScope timed (Timer ());
+        Change (Simulator::Now ().GetSeconds (), m_bytes ? -static_cast<int32_t> (item->GetSize ()) : -1);
+    }
+
+    void Flush ()
+    {
+        m_pending = false;
+        if (m_stats)
+            m_stats->Sample (m_pendingTime, m_value);
+        uint32_t distance = m_value > m_lastEmitted ? m_value - m_lastEmitted : m_lastEmitted - m_value;
+        if (distance > m_tolerance)
+            Emit (m_pendingTime, m_value);
+    }
+
+    void Emit (double time, uint32_t value)
+    {
+        if (m_sink)
+            m_sink (time, value);
+        m_lastEmitted = value;
+        m_emitted++;
+    }
+
+    uint32_t m_tolerance;
+    bool m_bytes;
+    QueueStats *m_stats;
+    Sink m_sink;
+    uint32_t m_value;
+    double m_pendingTime;
+    bool m_pending;
+    uint32_t m_lastEmitted;
+    uint64_t m_changes;
+    uint64_t m_emitted;
+};
+
+} // namespace ns3
+
+#endif /* RED_OCCUPANCY_H */
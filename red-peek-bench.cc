@@ -0,0 +1,92 @@
+/** Cost of reading the traced TCP fields from a queued packet
+ *
+ * Times what the enqueue/drop callbacks do per packet, on a segment shaped
+ * like the ones the scenarios queue (958 bytes of payload, a timestamp
+ * option, wrapped in an Ipv4QueueDiscItem):
+ *  - header:  item->GetPacket () and PeekHeader (TcpHeader&), as before
+ *  - peek:    PeekTcp () from red-tcp-peek.h
+ *
+ *   ./waf --run "red-peek-bench --iterations=5000000"
+ */
+
+#include <chrono>
+#include <cstdio>
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/internet-module.h"
+#include "ns3/traffic-control-module.h"
+
+#include "red-tcp-peek.h"
+
+using namespace ns3;
+
+static Ptr<QueueDiscItem>
+MakeItem ()
+{
+    Ptr<Packet> pkt = Create<Packet> (958);
+
+    TcpHeader tcp;
+    tcp.SetSourcePort (49153);
+    tcp.SetDestinationPort (8081);
+    tcp.SetSequenceNumber (SequenceNumber32 (123457));
+    tcp.SetAckNumber (SequenceNumber32 (1));
+    tcp.SetFlags (TcpHeader::ACK);
+    tcp.SetWindowSize (65535);
+    Ptr<TcpOptionTS> ts = CreateObject<TcpOptionTS> ();
+    ts->SetTimestamp (1000);
+    ts->SetEcho (999);
+    tcp.AppendOption (ts);
+    pkt->AddHeader (tcp);
+
+    Ipv4Header ip;
+    ip.SetSource (Ipv4Address ("10.1.1.1"));
+    ip.SetDestination (Ipv4Address ("10.1.5.2"));
+    ip.SetProtocol (TcpL4Protocol::PROT_NUMBER);
+    ip.SetPayloadSize (pkt->GetSize ());
+    return Create<Ipv4QueueDiscItem> (pkt, Address (), Ipv4L3Protocol::PROT_NUMBER, ip);
+}
+
+int
+main (int argc, char *argv[])
+{
+    uint32_t iterations = 2000000;
+
+    CommandLine cmd;
+    cmd.AddValue ("iterations", "Packets read per variant", iterations);
+    cmd.Parse (argc, argv);
+
+    Ptr<const QueueDiscItem> item = MakeItem ();
+    uint64_t check = 0;
+
+    auto start = std::chrono::steady_clock::now ();
+    for (uint32_t i = 0; i < iterations; ++i)
+    {
+        TcpHeader tcp;
+        Ptr<Packet> pkt = item->GetPacket ();
+        pkt->PeekHeader (tcp);
+        check += tcp.GetSequenceNumber ().GetValue () + tcp.GetDestinationPort ();
+    }
+    double header = std::chrono::duration<double, std::nano> (std::chrono::steady_clock::now () - start).count ();
+
+    start = std::chrono::steady_clock::now ();
+    for (uint32_t i = 0; i < iterations; ++i)
+    {
+        TcpFields tcp;
+        PeekTcp (item, tcp);
+        check -= tcp.sequence + tcp.destinationPort;
+    }
+    double peek = std::chrono::duration<double, std::nano> (std::chrono::steady_clock::now () - start).count ();
+
+    std::printf ("header\t%.1f ns/packet\n", header / iterations);
+    std::printf ("peek\t%.1f ns/packet\n", peek / iterations);
+    std::printf ("speedup\t%.1fx\n", peek > 0 ? header / peek : 0.0);
+
+    // The two paths must have read the same fields
+    if (check != 0)
+    {
+        std::printf ("fields differ\n");
+        return 1;
+    }
+    return 0;
+}
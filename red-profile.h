@@ -0,0 +1,173 @@
+/** Where a RED scenario spends its run time
+ *
+ * --profile=1 makes a scenario
+ *  - swap in CountingMapScheduler, the default map scheduler plus an
+ *    executed-event counter, and
+ *  - time every trace callback that opens a TimedScope on a
+ *    CallbackTimer.
+ * ReportProfile () adds the event count, the events per wall-clock second
+ * of Simulator::Run () and, per callback, the calls and nanoseconds spent
+ * to the run summary. redbench.py collects these across scenarios.
+ *
+ * Without --profile a TimedScope is one predictable branch.
+ */
+
+#ifndef RED_PROFILE_H
+#define RED_PROFILE_H
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "ns3/core-module.h"
+
+#include "red-run-summary.h"
+
+namespace ns3 {
+
+class CountingMapScheduler : public MapScheduler
+{
+public:
+    static TypeId GetTypeId (void)
+    {
+        static TypeId tid = TypeId ("ns3::CountingMapScheduler")
+            .SetParent<MapScheduler> ()
+            .SetGroupName ("Core")
+            .AddConstructor<CountingMapScheduler> ();
+        return tid;
+    }
+
+    virtual Scheduler::Event RemoveNext (void)
+    {
+        Executed ()++;
+        return MapScheduler::RemoveNext ();
+    }
+
+    static uint64_t &Executed ()
+    {
+        static uint64_t executed = 0;
+        return executed;
+    }
+};
+
+class CallbackTimer
+{
+public:
+    explicit CallbackTimer (const std::string &name)
+      : m_name (name),
+        m_calls (0),
+        m_ns (0)
+    {
+        Registry ().push_back (this);
+    }
+
+    static bool &Enabled ()
+    {
+        static bool enabled = false;
+        return enabled;
+    }
+
+    static std::vector<CallbackTimer *> &Registry ()
+    {
+        static std::vector<CallbackTimer *> timers;
+        return timers;
+    }
+
+    void Add (uint64_t ns)
+    {
+        m_calls++;
+        m_ns += ns;
+    }
+
+    const std::string &GetName () const
+    {
+        return m_name;
+    }
+
+    uint64_t GetCalls () const
+    {
+        return m_calls;
+    }
+
+    uint64_t GetNanoseconds () const
+    {
+        return m_ns;
+    }
+
+private:
+    std::string m_name;
+    uint64_t m_calls;
+    uint64_t m_ns;
+};
+
+// Charges the lifetime of the scope to a CallbackTimer
+class TimedScope
+{
+public:
+    explicit TimedScope (CallbackTimer &timer)
+      : m_timer (CallbackTimer::Enabled () ? &timer : nullptr)
+    {
+        if (m_timer)
+            m_start = std::chrono::steady_clock::now ();
+    }
+
+    ~TimedScope ()
+    {
+        if (m_timer)
+            m_timer->Add (std::chrono::duration_cast<std::chrono::nanoseconds> (
+                              std::chrono::steady_clock::now () - m_start).count ());
+    }
+
+private:
+    CallbackTimer *m_timer;
+    std::chrono::steady_clock::time_point m_start;
+};
+
+// Call right after cmd.Parse (), before anything is scheduled
+inline void
+EnableProfiling ()
+{
+    CallbackTimer::Enabled () = true;
+    ObjectFactory factory;
+    factory.SetTypeId (CountingMapScheduler::GetTypeId ());
+    Simulator::SetScheduler (factory);
+}
+
+// Wall-clock seconds since start
+inline double
+SecondsSince (std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double> (std::chrono::steady_clock::now () - start).count ();
+}
+
+inline void
+ReportProfile (RunSummary &summary, double runSeconds)
+{
+    summary.Add ("runSeconds", runSeconds);
+    if (!CallbackTimer::Enabled ())
+        return;
+
+    uint64_t events = CountingMapScheduler::Executed ();
+    summary.Add ("events", events);
+    summary.Add ("eventsPerSecond", runSeconds > 0 ? events / runSeconds : 0.0);
+
+    // The clock reads themselves, so callback times can be corrected
+    const int probes = 10000;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now ();
+    for (int i = 0; i < probes; ++i)
+        std::chrono::steady_clock::now ();
+    summary.Add ("profileClockNs", SecondsSince (start) * 1e9 / probes);
+
+    const std::vector<CallbackTimer *> &timers = CallbackTimer::Registry ();
+    for (size_t i = 0; i < timers.size (); ++i)
+    {
+        const CallbackTimer &t = *timers[i];
+        summary.Add ("profile" + t.GetName () + "Calls", t.GetCalls ());
+        summary.Add ("profile" + t.GetName () + "Ns", t.GetNanoseconds ());
+    }
+}
+
+} // namespace ns3
+
+#endif /* RED_PROFILE_H */
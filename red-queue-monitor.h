@@ -0,0 +1,665 @@
+/** Instrumentation for any number of queue discs
+ *
+ * p2c used to carry an A and a B copy of every callback, trace file,
+ * counter and statistics object, and every extra bottleneck meant another
+ * copy. QueueMonitor attaches the same instrumentation to each queue disc
+ * it is given, e.g. every disc a TrafficControlHelper::Install returned:
+ *
+ *  - queue size and average every 10 ms, or every change with event
+ *    occupancy (red-occupancy.h), into redQueue<name> and redQueue<name>Avg
+ *  - per-packet enqueue and drop records into PacketNum<name> and
+ *    PacketDrop<name>, carrying the queue's index as the queue id
+ *  - drop counts and QueueStats (red-queue-stats.h) for summary.txt
+ *  - with EnableSojourn (), the queueing delay of every packet
+ *    (red-sojourn.h) per queue, per time window and optionally per flow
+ *  - with CountMarks (), the ECN-capable arrivals and the packets this
+ *    disc marked Congestion Experienced, next to the drops
+ *  - with SetSizeClasses (), arrivals, drops and (with sojourn) queueing
+ *    delay per packet-size class over all queues, to see whether byte-mode
+ *    RED spares the small packets
+ *
+ * The per-queue state sits in one contiguous array. The trace callbacks are
+ * static functions bound to (monitor, index) with MakeBoundCallback, so one
+ * function serves every queue. The array may only grow until Start (): the
+ * occupancy trackers and the background trace writer hold pointers into it
+ * from then on.
+ */
+
+#ifndef RED_QUEUE_MONITOR_H
+#define RED_QUEUE_MONITOR_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <sstream>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "ns3/core-module.h"
+#include "ns3/traffic-control-module.h"
+
+#include "red-async-writer.h"
+#include "red-flow-table.h"
+#include "red-occupancy.h"
+#include "red-profile.h"
+#include "red-queue-stats.h"
+#include "red-run-summary.h"
+#include "red-sojourn.h"
+#include "red-tcp-peek.h"
+#include "red-trace-writer.h"
+
+namespace ns3 {
+
+class QueueMonitor
+{
+public:
+    struct Queue
+    {
+        std::string name;
+        Ptr<QueueDisc> queue;
+        Ptr<RedQueueDisc> red;
+        bool bytes;
+        uint32_t drops;
+        uint32_t marks;
+        uint32_t ectArrivals;
+        QueueStats stats;
+        OccupancyTracker occupancy;
+        TraceFileWriter plotQueue;
+        TraceFileWriter plotQueueAvg;
+        TraceFileWriter plotPacketArrive;
+        TraceFileWriter plotPacketDrop;
+        DelayHistogram delay;
+        DelayHistogram windowDelay;
+    };
+
+    // Packets of at most upTo IP bytes, larger than the previous class's
+    struct SizeClass
+    {
+        uint32_t upTo;
+        uint64_t arrivals;
+        uint64_t drops;
+        DelayHistogram delay;
+    };
+
+    explicit QueueMonitor (AsyncTraceWriter &traceOut)
+      : m_traceOut (traceOut),
+        m_ewmaWeight (0.002),
+        m_sampleInterval (Seconds (0.01)),
+        m_format (TraceFileWriter::TEXT),
+        m_eventOccupancy (false),
+        m_started (false),
+        m_sojourn (false),
+        m_sojournFile (nullptr),
+        m_marks (false),
+        m_window (0.1),
+        m_windowStart (0),
+        m_perFlow (false)
+    {
+    }
+
+    ~QueueMonitor ()
+    {
+        if (m_sojournFile)
+            std::fclose (m_sojournFile);
+    }
+
+    // Weight of the EWMA in every queue's statistics, normally RED's qw
+    void SetEwmaWeight (double weight)
+    {
+        m_ewmaWeight = weight;
+        for (size_t i = 0; i < m_queues.size (); ++i)
+            m_queues[i].stats.SetEwmaWeight (weight);
+    }
+
+    void SetSampleInterval (Time interval)
+    {
+        m_sampleInterval = interval;
+    }
+
+    // Measures the sojourn time of every packet from Start () on. With a
+    // path, per-window and end-of-run quantiles go to that file:
+    //   W <window>
+    //   T <windowStart> <queue> <packets> <p50> <p99> <p99.9>    (ms)
+    //   Q <queue> <name> <packets> <p50> <p90> <p99> <p99.9> <max>
+    //   F <src> <sport> <dst> <dport> <packets> <p50> <p90> <p99> <p99.9> <max>
+    //   S <class> <arrivals> <drops> <packets> <p50> <p90> <p99> <p99.9> <max>
+    // F lines need perFlow, S lines SetSizeClasses (). A flow crossing
+    // several monitored queues gets one sample per queue.
+    bool EnableSojourn (const std::string &path, double window, bool perFlow)
+    {
+        m_sojourn = true;
+        m_window = window;
+        m_perFlow = perFlow;
+        if (path.empty ())
+            return true;
+        m_sojournFile = std::fopen (path.c_str (), "w");
+        if (!m_sojournFile)
+            return false;
+        std::fprintf (m_sojournFile, "W %g\n", window);
+        return true;
+    }
+
+    // Counts ECN marks per queue. RED marks on enqueue, after the Enqueue
+    // trace, so a mark is a packet that arrived ECT and leaves CE; one an
+    // upstream queue marked arrives CE and is not counted again.
+    void CountMarks ()
+    {
+        m_marks = true;
+    }
+
+    // Splits the packets by size (IP bytes) at these upper bounds; one more
+    // class takes everything larger than the last
+    void SetSizeClasses (std::vector<uint32_t> bounds)
+    {
+        NS_ABORT_MSG_IF (m_started, "QueueMonitor: size classes must be set before Start ()");
+        std::sort (bounds.begin (), bounds.end ());
+        bounds.erase (std::unique (bounds.begin (), bounds.end ()), bounds.end ());
+        m_sizeBounds = bounds;
+        m_sizeClasses.assign (bounds.size () + (bounds.empty () ? 0 : 1), SizeClass ());
+        for (size_t k = 0; k < m_sizeClasses.size (); ++k)
+        {
+            m_sizeClasses[k].upTo = k < bounds.size () ? bounds[k] : 0;
+            m_sizeClasses[k].arrivals = 0;
+            m_sizeClasses[k].drops = 0;
+        }
+    }
+
+    // Instruments queue; name goes into the file names and summary keys.
+    // Returns the queue's index, which is also its id in packet records.
+    uint32_t Add (Ptr<QueueDisc> queue, const std::string &name)
+    {
+        NS_ABORT_MSG_IF (m_started, "QueueMonitor: queues must be added before Start ()");
+        uint32_t index = m_queues.size ();
+        m_queues.emplace_back ();
+        Queue &q = m_queues.back ();
+        q.name = name;
+        q.queue = queue;
+        q.red = DynamicCast<RedQueueDisc> (queue);
+        q.bytes = CountsBytes (queue);
+        q.drops = 0;
+        q.marks = 0;
+        q.ectArrivals = 0;
+        q.stats.SetEwmaWeight (m_ewmaWeight);
+
+        queue->TraceConnectWithoutContext ("Enqueue", MakeBoundCallback (&QueueMonitor::Enqueued, this, index));
+        queue->TraceConnectWithoutContext ("Drop", MakeBoundCallback (&QueueMonitor::Dropped, this, index));
+        return index;
+    }
+
+    // Instruments every disc of queues as prefix0, prefix1, ... (just prefix
+    // when there is only one)
+    void Add (const QueueDiscContainer &queues, const std::string &prefix)
+    {
+        for (uint32_t i = 0; i < queues.GetN (); ++i)
+        {
+            std::ostringstream name;
+            name << prefix;
+            if (queues.GetN () > 1)
+                name << i;
+            Add (queues.Get (i), name.str ());
+        }
+    }
+
+    // Opens the four trace files of every queue under pathOut
+    void OpenTraces (const std::string &pathOut, TraceFileWriter::Format format, uint32_t arriveColumns,
+                     uint32_t dropColumns)
+    {
+        m_format = format;
+        std::string ext = TraceFileWriter::Extension (format);
+        for (size_t i = 0; i < m_queues.size (); ++i)
+        {
+            Queue &q = m_queues[i];
+            q.plotQueue.Open (pathOut + "/redQueue" + q.name + ext, format, TraceFileWriter::SAMPLE);
+            q.plotQueueAvg.Open (pathOut + "/redQueue" + q.name + "Avg" + ext, format, TraceFileWriter::SAMPLE);
+            q.plotPacketArrive.Open (pathOut + "/PacketNum" + q.name + ext, format, TraceFileWriter::PACKET,
+                                     arriveColumns);
+            q.plotPacketDrop.Open (pathOut + "/PacketDrop" + q.name + ext, format, TraceFileWriter::PACKET,
+                                   dropColumns);
+        }
+    }
+
+    // Starts the samplers, or hooks the occupancy trackers when
+    // eventOccupancy is set. Runs even without trace files, the statistics
+    // go into the summary.
+    void Start (bool eventOccupancy, uint32_t tolerance)
+    {
+        m_started = true;
+        m_eventOccupancy = eventOccupancy;
+        m_windowStart = Simulator::Now ().GetSeconds ();
+        for (uint32_t i = 0; i < m_queues.size (); ++i)
+        {
+            Queue &q = m_queues[i];
+            if (m_sojourn || m_marks)
+                q.queue->TraceConnectWithoutContext ("Dequeue", MakeBoundCallback (&QueueMonitor::Dequeued, this, i));
+            if (!eventOccupancy)
+            {
+                Simulator::ScheduleNow (&QueueMonitor::Sample, this, i);
+                continue;
+            }
+            // Byte-mode RED's length is in bytes, and so are its thresholds
+            // and the tolerance: packets of MeanPktSize
+            if (q.bytes)
+            {
+                UintegerValue meanPktSize;
+                q.red->GetAttribute ("MeanPktSize", meanPktSize);
+                q.occupancy.SetByteMode (true);
+                q.occupancy.SetTolerance (tolerance * meanPktSize.Get ());
+            }
+            else
+                q.occupancy.SetTolerance (tolerance);
+            q.occupancy.SetStats (&q.stats);
+            q.occupancy.SetSink ([this, i] (double time, uint32_t qSize) {
+                Queue &q = m_queues[i];
+                m_traceOut.WriteSample (q.plotQueue, time, qSize);
+                m_traceOut.WriteSample (q.plotQueueAvg, time, q.stats.GetTimeAverage (time));
+            });
+            q.occupancy.Connect (q.queue);
+        }
+    }
+
+    // Emits the final occupancy points and writes the sojourn file; call
+    // after Simulator::Run ()
+    void Finish (double stopTime)
+    {
+        if (m_eventOccupancy)
+        {
+            for (size_t i = 0; i < m_queues.size (); ++i)
+                m_queues[i].occupancy.Finish (stopTime);
+        }
+        if (m_sojournFile)
+            WriteSojourn (stopTime);
+    }
+
+    // Drops every statistic gathered so far (drops, queue statistics and
+    // delays) so the summary covers only what follows, e.g. after a warm-up
+    void Restart ()
+    {
+        double now = Simulator::Now ().GetSeconds ();
+        for (size_t i = 0; i < m_queues.size (); ++i)
+        {
+            Queue &q = m_queues[i];
+            q.drops = 0;
+            q.marks = 0;
+            q.ectArrivals = 0;
+            q.stats.Restart (now);
+            q.delay.Reset ();
+            q.windowDelay.Reset ();
+        }
+        for (size_t i = 0; i < m_flowDelay.size (); ++i)
+            m_flowDelay[i].Reset ();
+        for (SizeClass &c : m_sizeClasses)
+        {
+            c.arrivals = 0;
+            c.drops = 0;
+            c.delay.Reset ();
+        }
+        m_windowStart = now;
+    }
+
+    // Per-queue drops<name>, meanQueue<name> and queue<name>* statistics,
+    // plus the totals drops and meanQueue (mean over the queues), and with
+    // CountMarks () marks<name>, marks and ectArrivals. A single unnamed
+    // queue reports only the totals and queue*; of the queue* statistics
+    // only TimeAvg, Min and Max compare across --occupancy modes (see
+    // red-queue-stats.h). Size classes report size<upTo>* (sizeOver<last>*
+    // for the largest) Arrivals, Drops, DropRate and, with sojourn, P50Ms
+    // and P99Ms.
+    void Report (RunSummary &summary, double stopTime) const
+    {
+        for (size_t i = 0; i < m_queues.size (); ++i)
+        {
+            const Queue &q = m_queues[i];
+            if (q.name.empty ())
+                continue;
+            summary.Add ("drops" + q.name, q.drops);
+            summary.Add ("meanQueue" + q.name, q.stats.GetTimeAverage (stopTime));
+        }
+        summary.Add ("drops", GetDrops ());
+        summary.Add ("meanQueue", GetMeanQueue (stopTime));
+        if (m_marks)
+        {
+            uint32_t marks = 0;
+            uint32_t ect = 0;
+            for (size_t i = 0; i < m_queues.size (); ++i)
+            {
+                const Queue &q = m_queues[i];
+                if (!q.name.empty ())
+                    summary.Add ("marks" + q.name, q.marks);
+                marks += q.marks;
+                ect += q.ectArrivals;
+            }
+            summary.Add ("marks", marks);
+            summary.Add ("ectArrivals", ect);
+        }
+        if (m_eventOccupancy)
+        {
+            uint64_t changes = 0;
+            uint64_t points = 0;
+            for (size_t i = 0; i < m_queues.size (); ++i)
+            {
+                changes += m_queues[i].occupancy.GetChanges ();
+                points += m_queues[i].occupancy.GetEmitted ();
+            }
+            summary.Add ("occupancyChanges", changes);
+            summary.Add ("occupancyPoints", points);
+        }
+        for (size_t i = 0; i < m_queues.size (); ++i)
+            m_queues[i].stats.Report (summary, "queue" + m_queues[i].name, stopTime);
+        for (size_t i = 0; m_sojourn && i < m_queues.size (); ++i)
+        {
+            const DelayHistogram &d = m_queues[i].delay;
+            std::string prefix = "sojourn" + m_queues[i].name;
+            summary.Add (prefix + "Count", d.GetCount ());
+            summary.Add (prefix + "P50Ms", d.Quantile (0.5) * 1e3);
+            summary.Add (prefix + "P90Ms", d.Quantile (0.9) * 1e3);
+            summary.Add (prefix + "P99Ms", d.Quantile (0.99) * 1e3);
+            summary.Add (prefix + "P999Ms", d.Quantile (0.999) * 1e3);
+            summary.Add (prefix + "MaxMs", d.GetMax () * 1e3);
+        }
+        for (size_t k = 0; k < m_sizeClasses.size (); ++k)
+        {
+            const SizeClass &c = m_sizeClasses[k];
+            std::string prefix = GetSizeClassName (k);
+            summary.Add (prefix + "Arrivals", c.arrivals);
+            summary.Add (prefix + "Drops", c.drops);
+            summary.Add (prefix + "DropRate", c.arrivals > 0 ? static_cast<double> (c.drops) / c.arrivals : 0.0);
+            if (!m_sojourn)
+                continue;
+            summary.Add (prefix + "P50Ms", c.delay.Quantile (0.5) * 1e3);
+            summary.Add (prefix + "P99Ms", c.delay.Quantile (0.99) * 1e3);
+        }
+    }
+
+    // size<upTo>, or sizeOver<last bound> for the largest class
+    std::string GetSizeClassName (size_t k) const
+    {
+        if (k < m_sizeBounds.size ())
+            return "size" + std::to_string (m_sizeBounds[k]);
+        return "sizeOver" + std::to_string (m_sizeBounds.back ());
+    }
+
+    // Closes every trace file, converting binary/columnar ones to .plot
+    // text when exportText is set; the trace writer must be stopped first
+    void CloseTraces (bool exportText)
+    {
+        for (size_t i = 0; i < m_queues.size (); ++i)
+        {
+            Queue &q = m_queues[i];
+            TraceFileWriter *plots[] = {&q.plotQueue, &q.plotQueueAvg, &q.plotPacketArrive, &q.plotPacketDrop};
+            for (TraceFileWriter *plot : plots)
+            {
+                bool wasOpen = plot->IsOpen ();
+                plot->Close ();
+                if (wasOpen && exportText && m_format != TraceFileWriter::TEXT)
+                {
+                    std::string path = plot->GetPath ();
+                    TraceFileWriter::ExportText (path, path.substr (0, path.rfind ('.')) + ".plot");
+                }
+            }
+        }
+    }
+
+    // Trace records lost to short writes; complete after CloseTraces ()
+    uint64_t GetTraceLost () const
+    {
+        uint64_t lost = 0;
+        for (const Queue &q : m_queues)
+            lost += q.plotQueue.GetLost () + q.plotQueueAvg.GetLost () + q.plotPacketArrive.GetLost ()
+                    + q.plotPacketDrop.GetLost ();
+        return lost;
+    }
+
+    uint32_t GetN () const
+    {
+        return m_queues.size ();
+    }
+
+    const Queue &Get (uint32_t index) const
+    {
+        return m_queues[index];
+    }
+
+    uint32_t GetDrops () const
+    {
+        uint32_t drops = 0;
+        for (size_t i = 0; i < m_queues.size (); ++i)
+            drops += m_queues[i].drops;
+        return drops;
+    }
+
+    // Time-averaged queue length up to now, averaged over the queues
+    double GetMeanQueue (double now) const
+    {
+        if (m_queues.empty ())
+            return 0.0;
+        double sum = 0;
+        for (size_t i = 0; i < m_queues.size (); ++i)
+            sum += m_queues[i].stats.GetTimeAverage (now);
+        return sum / m_queues.size ();
+    }
+
+    // The disc's queued packets, bytes for byte-mode RED (see GetOccupancy)
+    static uint32_t Length (const Queue &q)
+    {
+        return GetOccupancy (q.queue, q.bytes);
+    }
+
+private:
+    SizeClass *ClassOf (Ptr<const QueueDiscItem> item)
+    {
+        if (m_sizeClasses.empty ())
+            return nullptr;
+        size_t k = std::lower_bound (m_sizeBounds.begin (), m_sizeBounds.end (), item->GetSize ()) - m_sizeBounds.begin ();
+        return &m_sizeClasses[k];
+    }
+
+    static CallbackTimer &EnqueueTimer ()
+    {
+        static CallbackTimer timer ("Enqueue");
+        return timer;
+    }
+
+    static CallbackTimer &DropTimer ()
+    {
+        static CallbackTimer timer ("Drop");
+        return timer;
+    }
+
+    static CallbackTimer &SojournTimer ()
+    {
+        static CallbackTimer timer ("Sojourn");
+        return timer;
+    }
+
+    static CallbackTimer &SampleTimer ()
+    {
+        static CallbackTimer timer ("Sample");
+        return timer;
+    }
+
+    // The sequence number is in bytes not packets
+    static void Enqueued (QueueMonitor *monitor, uint32_t index, Ptr<const QueueDiscItem> item)
+    {
+        TimedScope timed (EnqueueTimer ());
+        Queue &q = monitor->m_queues[index];
+        // The disc has already counted the packet; RED averages the length before it
+        q.stats.Arrival (ArrivalOccupancy (q.queue, q.bytes, item));
+        if (monitor->m_sojourn)
+            monitor->Stamp (item);
+        if (monitor->m_marks)
+        {
+            Ipv4Header::EcnType ecn = GetEcn (item);
+            if (ecn != Ipv4Header::ECN_NotECT)
+                q.ectArrivals++;
+            if (ecn == Ipv4Header::ECN_ECT0 || ecn == Ipv4Header::ECN_ECT1)
+                monitor->m_ectQueued.insert (item->GetPacket ()->GetUid ());
+        }
+        if (SizeClass *c = monitor->ClassOf (item))
+            c->arrivals++;
+
+        TcpFields tcp;
+        if (!q.plotPacketArrive.IsOpen () || !PeekTcp (item, tcp))
+            return;
+
+        monitor->m_traceOut.WritePacket (q.plotPacketArrive, Simulator::Now ().GetSeconds (), tcp.sequence,
+                                         tcp.destinationPort, index);
+    }
+
+    static void Dropped (QueueMonitor *monitor, uint32_t index, Ptr<const QueueDiscItem> item)
+    {
+        TimedScope timed (DropTimer ());
+        Queue &q = monitor->m_queues[index];
+        q.drops++;
+        if (SizeClass *c = monitor->ClassOf (item))
+            c->drops++;
+        if (monitor->m_marks)
+            monitor->m_ectQueued.erase (item->GetPacket ()->GetUid ());
+        if (monitor->m_sojourn)
+        {
+            int64_t ns;
+            uint32_t flow;
+            monitor->m_stamps.Take (item->GetPacket ()->GetUid (), ns, flow);
+        }
+
+        TcpFields tcp;
+        if (!q.plotPacketDrop.IsOpen () || !PeekTcp (item, tcp))
+            return;
+
+        monitor->m_traceOut.WritePacket (q.plotPacketDrop, Simulator::Now ().GetSeconds (), tcp.sequence,
+                                         tcp.destinationPort, index);
+    }
+
+    static const uint32_t NO_FLOW = 0xffffffff;
+
+    void Stamp (Ptr<const QueueDiscItem> item)
+    {
+        uint32_t flow = NO_FLOW;
+        FlowKey key;
+        TcpFields tcp;
+        if (m_perFlow && FlowIndex::KeyOf (item, key, tcp))
+        {
+            bool isNew;
+            flow = m_flows.Find (key, isNew);
+            if (isNew)
+                m_flowDelay.push_back (DelayHistogram (5));
+        }
+        m_stamps.Insert (item->GetPacket ()->GetUid (), Simulator::Now ().GetNanoSeconds (), flow);
+    }
+
+    static void Dequeued (QueueMonitor *monitor, uint32_t index, Ptr<const QueueDiscItem> item)
+    {
+        TimedScope timed (SojournTimer ());
+        if (monitor->m_marks && monitor->m_ectQueued.erase (item->GetPacket ()->GetUid ()) > 0
+            && GetEcn (item) == Ipv4Header::ECN_CE)
+            monitor->m_queues[index].marks++;
+        int64_t enqueued;
+        uint32_t flow;
+        if (!monitor->m_sojourn || !monitor->m_stamps.Take (item->GetPacket ()->GetUid (), enqueued, flow))
+            return;
+
+        Time now = Simulator::Now ();
+        if (monitor->m_sojournFile && now.GetSeconds () >= monitor->m_windowStart + monitor->m_window)
+            monitor->CloseWindows (now.GetSeconds ());
+
+        uint64_t ns = now.GetNanoSeconds () - enqueued;
+        Queue &q = monitor->m_queues[index];
+        q.delay.Record (ns);
+        if (monitor->m_sojournFile)
+            q.windowDelay.Record (ns);
+        if (flow != NO_FLOW)
+            monitor->m_flowDelay[flow].Record (ns);
+        if (SizeClass *c = monitor->ClassOf (item))
+            c->delay.Record (ns);
+    }
+
+    // Writes a T line for every queue that delivered in the windows ending
+    // before now
+    void CloseWindows (double now)
+    {
+        for (size_t i = 0; i < m_queues.size (); ++i)
+        {
+            DelayHistogram &d = m_queues[i].windowDelay;
+            if (d.GetCount () == 0)
+                continue;
+            std::fprintf (m_sojournFile, "T %g %u %llu %.6f %.6f %.6f\n", m_windowStart, static_cast<uint32_t> (i),
+                          (unsigned long long) d.GetCount (), d.Quantile (0.5) * 1e3, d.Quantile (0.99) * 1e3,
+                          d.Quantile (0.999) * 1e3);
+            d.Reset ();
+        }
+        m_windowStart += m_window * std::floor ((now - m_windowStart) / m_window);
+    }
+
+    static void WriteQuantiles (FILE *f, const DelayHistogram &d)
+    {
+        std::fprintf (f, " %llu %.6f %.6f %.6f %.6f %.6f\n", (unsigned long long) d.GetCount (), d.Quantile (0.5) * 1e3,
+                      d.Quantile (0.9) * 1e3, d.Quantile (0.99) * 1e3, d.Quantile (0.999) * 1e3, d.GetMax () * 1e3);
+    }
+
+    void WriteSojourn (double stopTime)
+    {
+        CloseWindows (stopTime);
+        for (size_t i = 0; i < m_queues.size (); ++i)
+        {
+            const Queue &q = m_queues[i];
+            std::fprintf (m_sojournFile, "Q %u %s", static_cast<uint32_t> (i), q.name.empty () ? "-" : q.name.c_str ());
+            WriteQuantiles (m_sojournFile, q.delay);
+        }
+        for (uint32_t flow = 0; flow < m_flows.GetN (); ++flow)
+        {
+            const FlowKey &key = m_flows.Get (flow);
+            std::fprintf (m_sojournFile, "F %s %u %s %u", FlowIndex::Address (key.src).c_str (), key.sport,
+                          FlowIndex::Address (key.dst).c_str (), key.dport);
+            WriteQuantiles (m_sojournFile, m_flowDelay[flow]);
+        }
+        for (size_t k = 0; k < m_sizeClasses.size (); ++k)
+        {
+            const SizeClass &c = m_sizeClasses[k];
+            std::fprintf (m_sojournFile, "S %s %llu %llu", GetSizeClassName (k).c_str (),
+                          (unsigned long long) c.arrivals, (unsigned long long) c.drops);
+            WriteQuantiles (m_sojournFile, c.delay);
+        }
+        std::fclose (m_sojournFile);
+        m_sojournFile = nullptr;
+    }
+
+    void Sample (uint32_t index)
+    {
+        TimedScope timed (SampleTimer ());
+        Queue &q = m_queues[index];
+        uint32_t qSize = Length (q);
+        double now = Simulator::Now ().GetSeconds ();
+
+        q.stats.Sample (now, qSize);
+        Simulator::Schedule (m_sampleInterval, &QueueMonitor::Sample, this, index);
+
+        m_traceOut.WriteSample (q.plotQueue, now, qSize);
+        m_traceOut.WriteSample (q.plotQueueAvg, now, q.stats.GetMean ());
+    }
+
+    AsyncTraceWriter &m_traceOut;
+    std::vector<Queue> m_queues;
+    double m_ewmaWeight;
+    Time m_sampleInterval;
+    TraceFileWriter::Format m_format;
+    bool m_eventOccupancy;
+    bool m_started;
+    bool m_sojourn;
+    SojournStamps m_stamps;
+    FILE *m_sojournFile;
+    bool m_marks;
+    // Uids of the packets queued at any monitored disc that arrived ECT
+    std::unordered_set<uint64_t> m_ectQueued;
+    double m_window;
+    double m_windowStart;
+    bool m_perFlow;
+    FlowIndex m_flows;
+    std::vector<DelayHistogram> m_flowDelay;
+    std::vector<uint32_t> m_sizeBounds;
+    std::vector<SizeClass> m_sizeClasses;
+};
+
+} // namespace ns3
+
+#endif /* RED_QUEUE_MONITOR_H */
@@ -0,0 +1,303 @@
+/** Streaming queue statistics in constant memory
+ *
+ * One QueueStats per monitored queue replaces the avgQueueSize/checkTimes
+ * globals. Every Sample () updates, in O(1) time and memory:
+ *  - count, mean and variance (Welford),
+ *  - min and max,
+ *  - p50/p90/p99 through P-square quantile estimators (Jain & Chlamtac),
+ *  - the time-weighted occupancy, treating each sample as holding until
+ *    the next one.
+ * Count, mean, variance and the quantiles weigh every sample alike, so they
+ * are per 10 ms tick when polled (close to time-weighted) but per change
+ * with --occupancy=event; only the time average, min and max mean the same
+ * in both modes.
+ * Arrival () feeds the RED-style EWMA avg = (1 - qw) avg + qw q with the
+ * queue length seen by an arriving packet, which is how RedQueueDisc
+ * computes its own average (without the idle-period correction).
+ *
+ * Report () adds the aggregates to a RunSummary, so long runs can skip the
+ * per-sample time series and still get these numbers.
+ */
+
+#ifndef RED_QUEUE_STATS_H
+#define RED_QUEUE_STATS_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <string>
+
+#include "red-run-summary.h"
+
+namespace ns3 {
+
+// P-square estimator of a single quantile with five markers
+class P2Quantile
+{
+public:
+    explicit P2Quantile (double p)
+      : m_p (p),
+        m_count (0)
+    {
+    }
+
+    void Add (double x)
+    {
+        if (m_count < 5)
+        {
+            m_q[m_count++] = x;
+            if (m_count == 5)
+            {
+                std::sort (m_q, m_q + 5);
+                for (int i = 0; i < 5; ++i)
+                    m_n[i] = i;
+                m_np[0] = 0;
+                m_np[1] = 2 * m_p;
+                m_np[2] = 4 * m_p;
+                m_np[3] = 2 + 2 * m_p;
+                m_np[4] = 4;
+                m_dn[0] = 0;
+                m_dn[1] = m_p / 2;
+                m_dn[2] = m_p;
+                m_dn[3] = (1 + m_p) / 2;
+                m_dn[4] = 1;
+            }
+            return;
+        }
+
+        int k;
+        if (x < m_q[0])
+        {
+            m_q[0] = x;
+            k = 0;
+        }
+        else if (x >= m_q[4])
+        {
+            m_q[4] = x;
+            k = 3;
+        }
+        else
+        {
+            k = 0;
+            while (x >= m_q[k + 1])
+                k++;
+        }
+
+        for (int i = k + 1; i < 5; ++i)
+            m_n[i] += 1;
+        for (int i = 0; i < 5; ++i)
+            m_np[i] += m_dn[i];
+        m_count++;
+
+        for (int i = 1; i <= 3; ++i)
+        {
+            double d = m_np[i] - m_n[i];
+            if ((d >= 1 && m_n[i + 1] - m_n[i] > 1) || (d <= -1 && m_n[i - 1] - m_n[i] < -1))
+            {
+                int s = d >= 0 ? 1 : -1;
+                double q = Parabolic (i, s);
+                if (m_q[i - 1] < q && q < m_q[i + 1])
+                    m_q[i] = q;
+                else
+                    m_q[i] = m_q[i] + s * (m_q[i + s] - m_q[i]) / (m_n[i + s] - m_n[i]);
+                m_n[i] += s;
+            }
+        }
+    }
+
+    double Get () const
+    {
+        if (m_count == 0)
+            return 0;
+        if (m_count < 5)
+        {
+            double sorted[5];
+            std::copy (m_q, m_q + m_count, sorted);
+            std::sort (sorted, sorted + m_count);
+            return sorted[static_cast<int> (std::floor (m_p * (m_count - 1) + 0.5))];
+        }
+        return m_q[2];
+    }
+
+private:
+    double Parabolic (int i, int s) const
+    {
+        return m_q[i] + s / (m_n[i + 1] - m_n[i - 1])
+                            * ((m_n[i] - m_n[i - 1] + s) * (m_q[i + 1] - m_q[i]) / (m_n[i + 1] - m_n[i])
+                               + (m_n[i + 1] - m_n[i] - s) * (m_q[i] - m_q[i - 1]) / (m_n[i] - m_n[i - 1]));
+    }
+
+    double m_p;
+    uint64_t m_count;
+    double m_q[5];
+    double m_n[5];
+    double m_np[5];
+    double m_dn[5];
+};
+
+class QueueStats
+{
+public:
+    explicit QueueStats (double ewmaWeight = 0.002)
+      : m_weight (ewmaWeight),
+        m_count (0),
+        m_mean (0),
+        m_m2 (0),
+        m_min (std::numeric_limits<double>::infinity ()),
+        m_max (-std::numeric_limits<double>::infinity ()),
+        m_ewma (0),
+        m_arrivals (0),
+        m_p50 (0.5),
+        m_p90 (0.9),
+        m_p99 (0.99),
+        m_timed (false),
+        m_firstTime (0),
+        m_lastTime (0),
+        m_lastValue (0),
+        m_area (0)
+    {
+    }
+
+    void SetEwmaWeight (double weight)
+    {
+        m_weight = weight;
+    }
+
+    // A queue length observed at time (seconds), holding until the next sample
+    void Sample (double time, double value)
+    {
+        if (!m_timed)
+            m_firstTime = time;
+        else
+            m_area += m_lastValue * (time - m_lastTime);
+        m_timed = true;
+        m_lastTime = time;
+        m_lastValue = value;
+
+        m_count++;
+        double delta = value - m_mean;
+        m_mean += delta / m_count;
+        m_m2 += delta * (value - m_mean);
+        m_min = std::min (m_min, value);
+        m_max = std::max (m_max, value);
+        m_p50.Add (value);
+        m_p90.Add (value);
+        m_p99.Add (value);
+    }
+
+    // Queue length seen by an arriving packet, for the RED-style EWMA
+    void Arrival (double queueLength)
+    {
+        m_ewma = (1 - m_weight) * m_ewma + m_weight * queueLength;
+        m_arrivals++;
+    }
+
+    uint64_t GetCount () const
+    {
+        return m_count;
+    }
+
+    double GetMean () const
+    {
+        return m_mean;
+    }
+
+    double GetVariance () const
+    {
+        return m_count > 1 ? m_m2 / (m_count - 1) : 0.0;
+    }
+
+    double GetMin () const
+    {
+        return m_count > 0 ? m_min : 0.0;
+    }
+
+    double GetMax () const
+    {
+        return m_count > 0 ? m_max : 0.0;
+    }
+
+    double GetEwma () const
+    {
+        return m_ewma;
+    }
+
+    double GetP50 () const
+    {
+        return m_p50.Get ();
+    }
+
+    double GetP90 () const
+    {
+        return m_p90.Get ();
+    }
+
+    double GetP99 () const
+    {
+        return m_p99.Get ();
+    }
+
+    // Time-weighted mean occupancy from the first sample until now
+    double GetTimeAverage (double now) const
+    {
+        double span = now - m_firstTime;
+        if (!m_timed || span <= 0)
+            return m_lastValue;
+        return (m_area + m_lastValue * (now - m_lastTime)) / span;
+    }
+
+    // Forgets everything observed before now except the EWMA, which is
+    // state rather than a statistic; the time average restarts at now from
+    // the current length
+    void Restart (double now)
+    {
+        double weight = m_weight;
+        double ewma = m_ewma;
+        bool timed = m_timed;
+        double last = m_lastValue;
+        *this = QueueStats (weight);
+        m_ewma = ewma;
+        m_timed = timed;
+        m_firstTime = m_lastTime = now;
+        m_lastValue = last;
+    }
+
+    // Adds <prefix>Mean, <prefix>Var, ... to summary
+    void Report (RunSummary &summary, const std::string &prefix, double now) const
+    {
+        summary.Add (prefix + "Samples", m_count);
+        summary.Add (prefix + "Mean", GetMean ());
+        summary.Add (prefix + "Var", GetVariance ());
+        summary.Add (prefix + "Min", GetMin ());
+        summary.Add (prefix + "Max", GetMax ());
+        summary.Add (prefix + "P50", GetP50 ());
+        summary.Add (prefix + "P90", GetP90 ());
+        summary.Add (prefix + "P99", GetP99 ());
+        summary.Add (prefix + "TimeAvg", GetTimeAverage (now));
+        summary.Add (prefix + "Ewma", GetEwma ());
+        summary.Add (prefix + "Arrivals", m_arrivals);
+    }
+
+private:
+    double m_weight;
+    uint64_t m_count;
+    double m_mean;
+    double m_m2;
+    double m_min;
+    double m_max;
+    double m_ewma;
+    uint64_t m_arrivals;
+    P2Quantile m_p50;
+    P2Quantile m_p90;
+    P2Quantile m_p99;
+    bool m_timed;
+    double m_firstTime;
+    double m_lastTime;
+    double m_lastValue;
+    double m_area;
+};
+
+} // namespace ns3
+
+#endif /* RED_QUEUE_STATS_H */
@@ -0,0 +1,63 @@
+/** Per-run result summary for the RED scenarios
+ *
+ * Collects the end-of-run aggregates (sink throughput, drops, mean queue,
+ * the RED parameters that produced them) as ordered "key value" pairs and
+ * writes them to <pathOut>/summary.txt, one pair per line. redsweep.py
+ * reads these files back to build its results table.
+ */
+
+#ifndef RED_RUN_SUMMARY_H
+#define RED_RUN_SUMMARY_H
+
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace ns3 {
+
+class RunSummary
+{
+public:
+    void Add (const std::string &key, double value)
+    {
+        m_values.push_back (std::make_pair (key, value));
+    }
+
+    bool Write (const std::string &path) const
+    {
+        FILE *f = std::fopen (path.c_str (), "w");
+        if (!f)
+            return false;
+        for (size_t i = 0; i < m_values.size (); ++i)
+            std::fprintf (f, "%s %.17g\n", m_values[i].first.c_str (), m_values[i].second);
+        std::fclose (f);
+        return true;
+    }
+
+    // Appends the pairs of a file written by Write
+    bool Read (const std::string &path)
+    {
+        std::ifstream in (path.c_str ());
+        if (!in)
+            return false;
+        std::string key;
+        double value;
+        while (in >> key >> value)
+            Add (key, value);
+        return true;
+    }
+
+    const std::vector<std::pair<std::string, double> > &GetValues () const
+    {
+        return m_values;
+    }
+
+private:
+    std::vector<std::pair<std::string, double> > m_values;
+};
+
+} // namespace ns3
+
+#endif /* RED_RUN_SUMMARY_H */
@@ -0,0 +1,393 @@
+/** Declarative scenario description for red-scenario
+ *
+ * A scenario file lists nodes, point-to-point links, the queue discs to
+ * install and the flows to run, one directive per line ('#' starts a
+ * comment):
+ *
+ *   node   N1 N2 N5 N6
+ *   link   N1 N5 100Mbps 1ms
+ *   queue  N5 N6 red name=A [monitor=0] # disc on N5's device towards N6;
+ *                                      # red, ared, pie, codel, fqcodel, pfifo;
+ *                                      # monitor=0 installs it untraced and
+ *                                      # out of the summary totals
+ *   flow   N1 N6 8081 start=0.2 [stop=..] [rate=100Mbps]
+ *          [workload=poisson flows=50 size=20000 ...]    # see red-workload.h
+ *   red    minTh=5 maxTh=15 qw=0.002 queueLimit=40 meanPktSize=500 [ecn=1] [byteMode=1]
+ *   set    stopTime=1 packetSize=958 sourceRate=100Mbps
+ *
+ * Any token may hold a range "{a..b}". A node line lists every value of
+ * each range. Any other line with ranges is expanded into one line per
+ * value; when several tokens hold ranges they must have the same length
+ * and are stepped together, so
+ *
+ *   link L{1..500} R 100Mbps 1ms
+ *
+ * describes 500 links. This keeps parking-lot and dumbbell scenarios with
+ * hundreds of nodes to a handful of lines.
+ *
+ * Rates take the units bps, kbps, Kbps, Mbps and Gbps, delays s, ms, us
+ * and ns; a value with any other unit is an error.
+ *
+ * This header has no ns-3 dependency; red-scenario.cc turns a parsed
+ * ScenarioConfig into a simulation, and red-fluid.cc into a fluid model
+ * that screens RED settings before the packet-level runs.
+ */
+
+#ifndef RED_SCENARIO_CONFIG_H
+#define RED_SCENARIO_CONFIG_H
+
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace ns3 {
+
+struct ScenarioLink
+{
+    std::string a;
+    std::string b;
+    std::string rate;
+    std::string delay;
+};
+
+struct ScenarioQueue
+{
+    std::string from;
+    std::string to;
+    std::string type;
+    std::string name;
+    bool monitored;
+};
+
+struct ScenarioFlow
+{
+    std::string src;
+    std::string dst;
+    uint16_t port;
+    double start;
+    double stop;
+    std::string rate;
+    std::string workload;                              // kind, empty for --workload
+    std::map<std::string, std::string> workloadOptions;
+};
+
+class ScenarioConfig
+{
+public:
+    std::vector<std::string> nodes;
+    std::vector<ScenarioLink> links;
+    std::vector<ScenarioQueue> queues;
+    std::vector<ScenarioFlow> flows;
+    std::map<std::string, std::string> red;
+    std::map<std::string, std::string> settings;
+
+    // Returns false and fills error with "file:line: message" on bad input
+    bool Load (const std::string &path, std::string &error)
+    {
+        std::ifstream in (path.c_str ());
+        if (!in)
+        {
+            error = path + ": cannot open";
+            return false;
+        }
+
+        std::map<std::string, bool> known;
+        std::string line;
+        uint32_t lineNo = 0;
+        while (std::getline (in, line))
+        {
+            lineNo++;
+            std::string::size_type hash = line.find ('#');
+            if (hash != std::string::npos)
+                line.erase (hash);
+
+            std::vector<std::string> tokens = Split (line);
+            if (tokens.empty ())
+                continue;
+
+            std::vector<std::vector<std::string> > expanded;
+            std::string message;
+            bool ok = tokens[0] == "node" ? ExpandList (tokens, expanded) : Expand (tokens, expanded, message);
+            if (!ok || !Apply (expanded, known, message))
+            {
+                std::ostringstream os;
+                os << path << ":" << lineNo << ": " << message;
+                error = os.str ();
+                return false;
+            }
+        }
+        return true;
+    }
+
+    std::string GetSetting (const std::string &key, const std::string &fallback) const
+    {
+        std::map<std::string, std::string>::const_iterator it = settings.find (key);
+        return it == settings.end () ? fallback : it->second;
+    }
+
+    double GetSetting (const std::string &key, double fallback) const
+    {
+        std::map<std::string, std::string>::const_iterator it = settings.find (key);
+        return it == settings.end () ? fallback : std::atof (it->second.c_str ());
+    }
+
+    // ns-3 style rate/delay strings ("45Mbps", "0.5ms") in bits/s and
+    // seconds. Load () has checked every rate and delay of the file.
+    static double ParseRate (const std::string &rate)
+    {
+        double value = 0;
+        ParseWithUnits (rate, "bps", value);
+        return value;
+    }
+
+    static double ParseDelay (const std::string &delay)
+    {
+        double value = 0;
+        ParseWithUnits (delay, "s", value);
+        return value;
+    }
+
+private:
+    static std::vector<std::string> Split (const std::string &line)
+    {
+        std::vector<std::string> tokens;
+        std::istringstream is (line);
+        std::string token;
+        while (is >> token)
+            tokens.push_back (token);
+        return tokens;
+    }
+
+    // Expands "{a..b}" ranges; all ranges on a line are stepped together
+    static bool Expand (const std::vector<std::string> &tokens,
+                        std::vector<std::vector<std::string> > &out, std::string &error)
+    {
+        size_t count = 1;
+        bool ranged = false;
+        for (size_t i = 0; i < tokens.size (); ++i)
+        {
+            long lo, hi;
+            std::string prefix, suffix;
+            if (!FindRange (tokens[i], prefix, lo, hi, suffix))
+                continue;
+            size_t n = hi >= lo ? hi - lo + 1 : lo - hi + 1;
+            if (ranged && n != count)
+            {
+                error = "ranges on one line must have the same length";
+                return false;
+            }
+            ranged = true;
+            count = n;
+        }
+
+        out.assign (count, tokens);
+        for (size_t i = 0; i < tokens.size (); ++i)
+        {
+            long lo, hi;
+            std::string prefix, suffix;
+            if (!FindRange (tokens[i], prefix, lo, hi, suffix))
+                continue;
+            long step = hi >= lo ? 1 : -1;
+            for (size_t k = 0; k < count; ++k)
+            {
+                std::ostringstream os;
+                os << prefix << lo + step * static_cast<long> (k) << suffix;
+                out[k][i] = os.str ();
+            }
+        }
+        return true;
+    }
+
+    // Node lists expand every range in place: "node L{1..3} NA" is four nodes
+    static bool ExpandList (const std::vector<std::string> &tokens, std::vector<std::vector<std::string> > &out)
+    {
+        std::vector<std::string> line;
+        for (size_t i = 0; i < tokens.size (); ++i)
+        {
+            std::vector<std::string> single (1, tokens[i]);
+            std::vector<std::vector<std::string> > values;
+            std::string unused;
+            Expand (single, values, unused);
+            for (size_t k = 0; k < values.size (); ++k)
+                line.push_back (values[k][0]);
+        }
+        out.assign (1, line);
+        return true;
+    }
+
+    static bool FindRange (const std::string &token, std::string &prefix, long &lo, long &hi,
+                           std::string &suffix)
+    {
+        std::string::size_type open = token.find ('{');
+        std::string::size_type dots = token.find ("..", open);
+        std::string::size_type close = token.find ('}', dots);
+        if (open == std::string::npos || dots == std::string::npos || close == std::string::npos)
+            return false;
+        prefix = token.substr (0, open);
+        lo = std::atol (token.substr (open + 1, dots - open - 1).c_str ());
+        hi = std::atol (token.substr (dots + 2, close - dots - 2).c_str ());
+        suffix = token.substr (close + 1);
+        return true;
+    }
+
+    static void SplitOptions (const std::vector<std::string> &tokens, size_t first,
+                              std::vector<std::string> &positional, std::map<std::string, std::string> &options)
+    {
+        for (size_t i = first; i < tokens.size (); ++i)
+        {
+            std::string::size_type eq = tokens[i].find ('=');
+            if (eq == std::string::npos)
+                positional.push_back (tokens[i]);
+            else
+                options[tokens[i].substr (0, eq)] = tokens[i].substr (eq + 1);
+        }
+    }
+
+    bool CheckNode (const std::map<std::string, bool> &known, const std::string &node, std::string &error)
+    {
+        if (known.count (node))
+            return true;
+        error = "unknown node '" + node + "'";
+        return false;
+    }
+
+    bool Apply (const std::vector<std::vector<std::string> > &lines, std::map<std::string, bool> &known,
+                std::string &error)
+    {
+        for (size_t l = 0; l < lines.size (); ++l)
+        {
+            const std::vector<std::string> &tokens = lines[l];
+            const std::string &directive = tokens[0];
+            std::vector<std::string> args;
+            std::map<std::string, std::string> options;
+            SplitOptions (tokens, 1, args, options);
+
+            if (directive == "node")
+            {
+                for (size_t i = 0; i < args.size (); ++i)
+                {
+                    if (known.count (args[i]))
+                    {
+                        error = "node '" + args[i] + "' declared twice";
+                        return false;
+                    }
+                    known[args[i]] = true;
+                    nodes.push_back (args[i]);
+                }
+            }
+            else if (directive == "link")
+            {
+                if (args.size () != 4)
+                {
+                    error = "usage: link <a> <b> <rate> <delay>";
+                    return false;
+                }
+                if (!CheckNode (known, args[0], error) || !CheckNode (known, args[1], error)
+                    || !CheckUnits (args[2], "bps", "rate", error) || !CheckUnits (args[3], "s", "delay", error))
+                    return false;
+                ScenarioLink link = {args[0], args[1], args[2], args[3]};
+                links.push_back (link);
+            }
+            else if (directive == "queue")
+            {
+                if (args.size () != 3)
+                {
+                    error = "usage: queue <from> <to> <type> [name=..] [monitor=0]";
+                    return false;
+                }
+                if (!CheckNode (known, args[0], error) || !CheckNode (known, args[1], error))
+                    return false;
+                std::ostringstream name;
+                name << queues.size ();
+                ScenarioQueue queue = {args[0], args[1], args[2],
+                                       options.count ("name") ? options["name"] : name.str (),
+                                       !options.count ("monitor") || options["monitor"] != "0"};
+                queues.push_back (queue);
+            }
+            else if (directive == "flow")
+            {
+                if (args.size () != 3)
+                {
+                    error = "usage: flow <src> <dst> <port> [start=..] [stop=..] [rate=..] [workload=<kind> ..]";
+                    return false;
+                }
+                if (!CheckNode (known, args[0], error) || !CheckNode (known, args[1], error))
+                    return false;
+                ScenarioFlow flow;
+                flow.src = args[0];
+                flow.dst = args[1];
+                flow.port = static_cast<uint16_t> (std::atoi (args[2].c_str ()));
+                flow.start = options.count ("start") ? std::atof (options["start"].c_str ()) : 0.0;
+                flow.stop = options.count ("stop") ? std::atof (options["stop"].c_str ()) : -1.0;
+                flow.rate = options.count ("rate") ? options["rate"] : "";
+                if (!flow.rate.empty () && !CheckUnits (flow.rate, "bps", "rate", error))
+                    return false;
+                flow.workload = options.count ("workload") ? options["workload"] : "";
+                // Every other option belongs to the workload
+                for (const char *own : {"start", "stop", "rate", "workload"})
+                    options.erase (own);
+                flow.workloadOptions = options;
+                flows.push_back (flow);
+            }
+            else if (directive == "red")
+            {
+                for (std::map<std::string, std::string>::iterator it = options.begin (); it != options.end (); ++it)
+                    red[it->first] = it->second;
+            }
+            else if (directive == "set")
+            {
+                if (options.count ("sourceRate") && !CheckUnits (options["sourceRate"], "bps", "sourceRate", error))
+                    return false;
+                for (std::map<std::string, std::string>::iterator it = options.begin (); it != options.end (); ++it)
+                    settings[it->first] = it->second;
+            }
+            else
+            {
+                error = "unknown directive '" + directive + "'";
+                return false;
+            }
+        }
+        return true;
+    }
+
+    static bool CheckUnits (const std::string &text, const std::string &base, const std::string &what,
+                            std::string &error)
+    {
+        double value;
+        if (ParseWithUnits (text, base, value))
+            return true;
+        error = "bad " + what + " '" + text + "': no number or an unknown unit";
+        return false;
+    }
+
+    // False for a missing number or an unknown unit; a bare number is in base units
+    static bool ParseWithUnits (const std::string &text, const std::string &base, double &value)
+    {
+        char *end = nullptr;
+        value = std::strtod (text.c_str (), &end);
+        if (end == text.c_str ())
+            return false;
+        std::string unit (end);
+        if (unit.empty ())
+            return true;
+        static const char *prefixes[] = {"", "k", "K", "M", "G", "m", "u", "n"};
+        static const double scale[] = {1.0, 1e3, 1e3, 1e6, 1e9, 1e-3, 1e-6, 1e-9};
+        for (size_t i = 0; i < sizeof (scale) / sizeof (scale[0]); ++i)
+        {
+            if (unit == std::string (prefixes[i]) + base)
+            {
+                value *= scale[i];
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+} // namespace ns3
+
+#endif /* RED_SCENARIO_CONFIG_H */
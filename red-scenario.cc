@@ -0,0 +1,266 @@
+/** Config-driven RED scenario engine
+ *
+ * Builds the topology, queue discs and flows described by a scenario file
+ * (see red-scenario-config.h) instead of hardcoding them, so p2a/p2b/p2c
+ * and larger dumbbell or parking-lot variants run from the same binary:
+ *
+ *   ./waf --run "red-scenario --config=scratch/scenarios/p2c.conf"
+ *
+ * Every queue named by a "queue" directive is handed to a QueueMonitor
+ * (red-queue-monitor.h), like the hand-written programs: queue size and
+ * average every 10 ms (or at every change with --occupancy=event),
+ * per-packet enqueue and drop traces, and its drop count and queue
+ * statistics in summary.txt. Output files carry the queue name,
+ * e.g. redQueueA.plot and PacketDropA.plot. A queue with monitor=0 is
+ * installed but not watched, as p2a and p2b do with the ACK direction of
+ * their bottleneck.
+ */
+
+#include <cstring>
+#include <map>
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/internet-module.h"
+#include "ns3/point-to-point-module.h"
+#include "ns3/applications-module.h"
+#include "ns3/traffic-control-module.h"
+
+#include "red-common.h"
+#include "red-harness.h"
+#include "red-run-summary.h"
+#include "red-scenario-config.h"
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("RedScenario");
+
+RedHarness harness ("RedScenario");
+
+// Scenario files may set RED values; the command line overrides them
+static void
+ApplyConfigRed (const ScenarioConfig &config, RedParams &red)
+{
+    for (std::map<std::string, std::string>::const_iterator it = config.red.begin (); it != config.red.end (); ++it)
+    {
+        const std::string &key = it->first;
+        const char *value = it->second.c_str ();
+        if (key == "minTh")
+            red.minTh = std::atof (value);
+        else if (key == "maxTh")
+            red.maxTh = std::atof (value);
+        else if (key == "qw")
+            red.qw = std::atof (value);
+        else if (key == "queueLimit")
+            red.queueLimit = std::atoi (value);
+        else if (key == "meanPktSize")
+            red.meanPktSize = std::atoi (value);
+        else if (key == "wait")
+            red.wait = std::atoi (value) != 0;
+        else if (key == "gentle")
+            red.gentle = std::atoi (value) != 0;
+        else if (key == "ecn")
+            red.ecn = std::atoi (value) != 0;
+        else if (key == "byteMode")
+            red.byteMode = std::atoi (value) != 0;
+        else
+            NS_FATAL_ERROR ("unknown red option '" << key << "' in scenario file");
+    }
+}
+
+static Ipv4Address
+PrimaryAddress (Ptr<Node> node)
+{
+    Ptr<Ipv4> ipv4 = node->GetObject<Ipv4> ();
+    NS_ABORT_MSG_IF (ipv4->GetNInterfaces () < 2, "node " << Names::FindName (node) << " has no links");
+    return ipv4->GetAddress (1, 0).GetLocal ();
+}
+
+int
+main (int argc, char *argv[])
+{
+    std::string configPath = "scratch/scenarios/p2a.conf";
+
+    // The scenario file supplies the defaults the rest of the command line overrides
+    for (int i = 1; i < argc; ++i)
+    {
+        if (std::strncmp (argv[i], "--config=", 9) == 0)
+            configPath = argv[i] + 9;
+    }
+
+    ScenarioConfig config;
+    std::string error;
+    if (!config.Load (configPath, error))
+        NS_FATAL_ERROR (error);
+
+    RedParams &red = harness.red;
+    red.aqm.clear ();  // the queue directives choose unless --aqm is given
+    ApplyConfigRed (config, red);
+    harness.stopTime = config.GetSetting ("stopTime", 1.0);
+    uint32_t packetSize = static_cast<uint32_t> (config.GetSetting ("packetSize", 1000.0 - 42));
+    std::string sourceRate = config.GetSetting ("sourceRate", std::string ("100Mbps"));
+
+    CommandLine cmd;
+    cmd.AddValue ("config", "Scenario file describing nodes, links, queues and flows", configPath);
+    harness.AddValues (cmd);
+    cmd.Parse (argc, argv);
+    harness.Configure ();
+
+    NS_LOG_INFO ("Set RED params");
+    harness.ApplyDefaults (packetSize);
+
+    // Again, so --ns3::RedQueueDisc::... and --ns3::TcpSocket::... attribute
+    // overrides win over the defaults above
+    cmd.Parse (argc, argv);
+
+    NS_LOG_INFO ("Create " << config.nodes.size () << " nodes");
+    NodeContainer c;
+    c.Create (config.nodes.size ());
+    std::map<std::string, Ptr<Node> > nodeByName;
+    for (uint32_t i = 0; i < config.nodes.size (); ++i)
+    {
+        Names::Add (config.nodes[i], c.Get (i));
+        nodeByName[config.nodes[i]] = c.Get (i);
+    }
+
+    InternetStackHelper internet;
+    internet.Install (c);
+
+    // One helper for every link; attributes are only touched when they change
+    NS_LOG_INFO ("Create " << config.links.size () << " links");
+    PointToPointHelper p2p;
+    std::string currentRate;
+    std::string currentDelay;
+    std::vector<NetDeviceContainer> linkDevices;
+    linkDevices.reserve (config.links.size ());
+    std::map<std::string, Ptr<NetDevice> > deviceByDirection;
+    std::map<std::string, const ScenarioLink *> linkByDirection;
+    for (uint32_t i = 0; i < config.links.size (); ++i)
+    {
+        const ScenarioLink &link = config.links[i];
+        if (link.rate != currentRate)
+        {
+            p2p.SetDeviceAttribute ("DataRate", StringValue (link.rate));
+            currentRate = link.rate;
+        }
+        if (link.delay != currentDelay)
+        {
+            p2p.SetChannelAttribute ("Delay", StringValue (link.delay));
+            currentDelay = link.delay;
+        }
+        NetDeviceContainer devs = p2p.Install (nodeByName[link.a], nodeByName[link.b]);
+        linkDevices.push_back (devs);
+        deviceByDirection[link.a + "|" + link.b] = devs.Get (0);
+        deviceByDirection[link.b + "|" + link.a] = devs.Get (1);
+        linkByDirection[link.a + "|" + link.b] = &link;
+        linkByDirection[link.b + "|" + link.a] = &link;
+    }
+
+    // Queue discs go in before the addresses so they replace the default root disc
+    NS_LOG_INFO ("Install queue discs");
+    std::string slowestQueueRate;
+    for (uint32_t i = 0; i < config.queues.size (); ++i)
+    {
+        const ScenarioQueue &sq = config.queues[i];
+        std::string key = sq.from + "|" + sq.to;
+        NS_ABORT_MSG_UNLESS (deviceByDirection.count (key), "queue " << sq.name << ": no link " << sq.from << " - " << sq.to);
+        std::string aqm = red.aqm.empty () ? sq.type : red.aqm;
+        NS_ABORT_MSG_UNLESS (IsKnownAqm (aqm), "queue " << sq.name << ": unsupported type " << aqm);
+
+        const ScenarioLink *link = linkByDirection[key];
+        TrafficControlHelper tchRed;
+        SetRootAqm (tchRed, aqm, red, link->rate, link->delay);
+
+        Ptr<QueueDisc> disc = tchRed.Install (deviceByDirection[key]).Get (0);
+        if (!sq.monitored)
+            continue;
+        harness.monitor.Add (disc, sq.name);
+        if (slowestQueueRate.empty () || ScenarioConfig::ParseRate (link->rate) < ScenarioConfig::ParseRate (slowestQueueRate))
+            slowestQueueRate = link->rate;
+    }
+    // The slowest monitored link is the bottleneck of the ideal completion times
+    if (!slowestQueueRate.empty ())
+        harness.workload.SetLineRate (slowestQueueRate);
+
+    NS_LOG_INFO ("Assign IP Addresses");
+    Ipv4AddressHelper ipv4;
+    ipv4.SetBase ("10.0.0.0", "255.255.255.0");
+    for (uint32_t i = 0; i < linkDevices.size (); ++i)
+    {
+        ipv4.Assign (linkDevices[i]);
+        ipv4.NewNetwork ();
+    }
+
+    Ipv4GlobalRoutingHelper::PopulateRoutingTables ();
+
+    //Install Sources
+    NS_LOG_INFO ("Install " << config.flows.size () << " flows");
+    PacketSinkHelper sinkHelper ("ns3::TcpSocketFactory", Address ());
+    ApplicationContainer sinks;
+    std::map<std::pair<std::string, uint16_t>, bool> haveSink;
+
+    for (uint32_t i = 0; i < config.flows.size (); ++i)
+    {
+        const ScenarioFlow &flow = config.flows[i];
+        Ptr<Node> dst = nodeByName[flow.dst];
+
+        // A line without workload= takes --workload, its options on top
+        WorkloadSpec spec = harness.workload.GetSpec ();
+        if (!flow.workload.empty ())
+        {
+            spec.kind = flow.workload;
+            spec.options.clear ();
+        }
+        for (const std::pair<const std::string, std::string> &option : flow.workloadOptions)
+            spec.options[option.first] = option.second;
+        NS_ABORT_MSG_UNLESS (spec.Check (error), "flow " << flow.src << "->" << flow.dst << ": " << error);
+
+        ApplicationContainer source = harness.workload.Install (spec, nodeByName[flow.src],
+                                                                InetSocketAddress (PrimaryAddress (dst), flow.port),
+                                                                flow.rate.empty () ? sourceRate : flow.rate, packetSize);
+        StartWithJitter (source, flow.start, harness.startJitter);
+        if (flow.stop > 0)
+            source.Stop (Seconds (flow.stop));
+
+        std::pair<std::string, uint16_t> sinkKey (flow.dst, flow.port);
+        if (!haveSink[sinkKey])
+        {
+            haveSink[sinkKey] = true;
+            sinkHelper.SetAttribute ("Local", AddressValue (InetSocketAddress (Ipv4Address::GetAny (), flow.port)));
+            sinks.Add (sinkHelper.Install (dst));
+        }
+    }
+    sinks.Start (Seconds (0));
+
+    // One UDP stream of the --sizeMix sizes beside every flow
+    if (harness.sizeMix.IsEnabled ())
+    {
+        std::map<std::string, bool> haveMixSink;
+        for (const ScenarioFlow &flow : config.flows)
+        {
+            harness.sizeMix.Install (nodeByName[flow.src], PrimaryAddress (nodeByName[flow.dst]), flow.start);
+            if (!haveMixSink[flow.dst])
+            {
+                haveMixSink[flow.dst] = true;
+                harness.sizeMix.InstallSink (nodeByName[flow.dst]);
+            }
+        }
+    }
+
+    harness.Start (sinks, TraceFileWriter::COL_SEQ | TraceFileWriter::COL_PORT,
+                   TraceFileWriter::COL_SEQ | TraceFileWriter::COL_PORT);
+    if (!harness.Run ())
+        return harness.GetForkStatus ();
+    harness.Finish ();
+
+    if (harness.IsWritingSummary ())
+    {
+        RunSummary summary;
+        harness.Report (summary);
+        harness.WriteSummary (summary);
+    }
+
+    harness.Close ();
+
+    return 0;
+}
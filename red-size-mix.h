@@ -0,0 +1,308 @@
+/** Mixed packet-size traffic from an empirical distribution
+ *
+ * Every TCP source sends packetSize segments, so RED only ever sees
+ * 1000-byte packets and their ACKs. A SizeMix adds UDP sources whose packet
+ * sizes are drawn from a size file, e.g. the IMIX of
+ * scenarios/sizes-imix.txt:
+ *
+ *   # <IP packet bytes> <cumulative probability>
+ *   40    0.583333
+ *   576   0.916667
+ *   1500  1
+ *
+ * Sizes are whole IP packets (the 28 bytes of IP and UDP headers come out
+ * of the payload), strictly increasing, with a non-decreasing cumulative
+ * probability that is scaled to end at 1. A source sends Poisson arrivals
+ * averaging --mixRate, the gap after a packet being exponential with mean
+ * size * 8 / rate. UDP keeps the sizes exact: TCP would resegment them.
+ *
+ * --sizeClasses="100,600" sets the upper bounds (IP bytes) of the size
+ * classes the QueueMonitor reports drops and sojourn times for; a size
+ * file makes every size in it a class by default.
+ *
+ * Each source draws from two fixed random streams (FIRST_STREAM + 2 * its
+ * index), so the mix is the same whether or not the other applications
+ * exist, as with p2c --mpi where a rank only installs its own.
+ */
+
+#ifndef RED_SIZE_MIX_H
+#define RED_SIZE_MIX_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/internet-module.h"
+#include "ns3/applications-module.h"
+
+#include "red-run-summary.h"
+
+namespace ns3 {
+
+// Discrete packet-size distribution read from a size file
+class SizeDistribution
+{
+public:
+    bool Load (const std::string &path, std::string &error)
+    {
+        m_sizes.clear ();
+        m_cdf.clear ();
+        std::ifstream in (path.c_str ());
+        if (!in)
+        {
+            error = "cannot read size file " + path;
+            return false;
+        }
+        std::string line;
+        uint32_t lineNo = 0;
+        while (std::getline (in, line))
+        {
+            lineNo++;
+            line = line.substr (0, line.find ('#'));
+            std::istringstream fields (line);
+            double size;
+            double cdf;
+            if (!(fields >> size))
+                continue;
+            if (!(fields >> cdf) || size < HEADER_BYTES + 1 || size > 65535
+                || (!m_sizes.empty () && (size <= m_sizes.back () || cdf < m_cdf.back ())))
+            {
+                error = path + ":" + std::to_string (lineNo)
+                        + ": expected <bytes> <cumulative probability>, sizes increasing from "
+                        + std::to_string (HEADER_BYTES + 1) + " and probabilities non-decreasing";
+                return false;
+            }
+            m_sizes.push_back (static_cast<uint32_t> (size));
+            m_cdf.push_back (cdf);
+        }
+        if (m_sizes.empty () || m_cdf.back () <= 0)
+        {
+            error = "size file " + path + " holds no probability";
+            return false;
+        }
+        for (double &p : m_cdf)
+            p /= m_cdf.back ();
+        return true;
+    }
+
+    // The size whose cumulative probability first reaches u, u in [0, 1)
+    uint32_t Draw (double u) const
+    {
+        size_t i = std::upper_bound (m_cdf.begin (), m_cdf.end (), u) - m_cdf.begin ();
+        return m_sizes[std::min (i, m_sizes.size () - 1)];
+    }
+
+    double GetMean () const
+    {
+        double mean = 0;
+        double previous = 0;
+        for (size_t i = 0; i < m_sizes.size (); ++i)
+        {
+            mean += m_sizes[i] * (m_cdf[i] - previous);
+            previous = m_cdf[i];
+        }
+        return mean;
+    }
+
+    const std::vector<uint32_t> &GetSizes () const
+    {
+        return m_sizes;
+    }
+
+    // IPv4 and UDP headers
+    static const uint32_t HEADER_BYTES = 28;
+
+private:
+    std::vector<uint32_t> m_sizes;
+    std::vector<double> m_cdf;
+};
+
+// UDP source sending Poisson arrivals of SizeDistribution packets
+class SizeMixSource : public Application
+{
+public:
+    static TypeId GetTypeId (void)
+    {
+        static TypeId tid = TypeId ("ns3::SizeMixSource")
+            .SetParent<Application> ()
+            .SetGroupName ("Applications")
+            .AddConstructor<SizeMixSource> ();
+        return tid;
+    }
+
+    SizeMixSource ()
+      : m_sizes (nullptr),
+        m_bps (0),
+        m_sent (0)
+    {
+        m_size = CreateObject<UniformRandomVariable> ();
+        m_gap = CreateObject<ExponentialRandomVariable> ();
+        m_gap->SetAttribute ("Mean", DoubleValue (1));
+    }
+
+    void Setup (const SizeDistribution *sizes, Address remote, DataRate rate, int64_t stream)
+    {
+        m_sizes = sizes;
+        m_remote = remote;
+        m_bps = rate.GetBitRate ();
+        m_size->SetStream (stream);
+        m_gap->SetStream (stream + 1);
+    }
+
+    // IP bytes handed to the socket
+    uint64_t GetSentBytes () const
+    {
+        return m_sent;
+    }
+
+protected:
+    virtual void DoDispose (void)
+    {
+        m_socket = nullptr;
+        Application::DoDispose ();
+    }
+
+private:
+    virtual void StartApplication (void)
+    {
+        m_socket = Socket::CreateSocket (GetNode (), UdpSocketFactory::GetTypeId ());
+        m_socket->Bind ();
+        m_socket->Connect (m_remote);
+        Send ();
+    }
+
+    virtual void StopApplication (void)
+    {
+        Simulator::Cancel (m_next);
+        if (m_socket)
+            m_socket->Close ();
+    }
+
+    void Send ()
+    {
+        uint32_t size = m_sizes->Draw (m_size->GetValue ());
+        if (m_socket->Send (Create<Packet> (size - SizeDistribution::HEADER_BYTES)) >= 0)
+            m_sent += size;
+        m_next = Simulator::Schedule (Seconds (m_gap->GetValue () * size * 8.0 / m_bps), &SizeMixSource::Send, this);
+    }
+
+    const SizeDistribution *m_sizes;
+    Address m_remote;
+    double m_bps;
+    Ptr<UniformRandomVariable> m_size;
+    Ptr<ExponentialRandomVariable> m_gap;
+    Ptr<Socket> m_socket;
+    EventId m_next;
+    uint64_t m_sent;
+};
+
+class SizeMix
+{
+public:
+    SizeMix ()
+      : m_rate ("5Mbps"),
+        m_nSources (0)
+    {
+    }
+
+    void AddValues (CommandLine &cmd)
+    {
+        cmd.AddValue ("sizeMix", "Size file (see red-size-mix.h); adds a UDP source of those packet sizes beside the TCP sources", m_path);
+        cmd.AddValue ("mixRate", "Mean rate of every --sizeMix source", m_rate);
+        cmd.AddValue ("sizeClasses", "Upper bounds (IP bytes) of the size classes with their own drop and delay statistics, e.g. \"100,600\"", m_classList);
+    }
+
+    bool IsEnabled () const
+    {
+        return !m_path.empty ();
+    }
+
+    // Reads the size file and the class list; call after cmd.Parse ()
+    bool Load (std::string &error)
+    {
+        m_classes.clear ();
+        std::istringstream in (m_classList);
+        std::string part;
+        while (std::getline (in, part, ','))
+            if (!part.empty ())
+                m_classes.push_back (static_cast<uint32_t> (std::atoi (part.c_str ())));
+        if (!IsEnabled ())
+            return true;
+        if (!m_sizes.Load (m_path, error))
+            return false;
+        if (m_classes.empty ())
+            m_classes = m_sizes.GetSizes ();
+        return true;
+    }
+
+    // Upper bounds for QueueMonitor::SetSizeClasses; empty when neither
+    // --sizeClasses nor --sizeMix is given
+    const std::vector<uint32_t> &GetSizeClasses () const
+    {
+        return m_classes;
+    }
+
+    // Starts a source on src sending to dst at start
+    void Install (Ptr<Node> src, Ipv4Address dst, double start)
+    {
+        Ptr<SizeMixSource> source = CreateObject<SizeMixSource> ();
+        source->Setup (&m_sizes, InetSocketAddress (dst, PORT), DataRate (m_rate), FIRST_STREAM + 2 * m_nSources++);
+        src->AddApplication (source);
+        source->SetStartTime (Seconds (start));
+        m_sources.push_back (source);
+    }
+
+    // The UDP sink of the sources sending to node
+    void InstallSink (Ptr<Node> node)
+    {
+        PacketSinkHelper sinkHelper ("ns3::UdpSocketFactory", InetSocketAddress (Ipv4Address::GetAny (), PORT));
+        m_sinks.Add (sinkHelper.Install (node));
+    }
+
+    // Counts a source installed by another MPI rank, so the random streams
+    // stay those of the serial run
+    void Skip ()
+    {
+        m_nSources++;
+    }
+
+    // mixSources, mixMeanBytes and the bytes the sources sent and the
+    // sinks received
+    void Report (RunSummary &summary) const
+    {
+        uint64_t sent = 0;
+        for (const Ptr<SizeMixSource> &source : m_sources)
+            sent += source->GetSentBytes ();
+        uint64_t received = 0;
+        for (uint32_t i = 0; i < m_sinks.GetN (); ++i)
+            received += DynamicCast<PacketSink> (m_sinks.Get (i))->GetTotalRx ();
+        summary.Add ("mixSources", m_sources.size ());
+        summary.Add ("mixMeanBytes", m_sizes.GetMean ());
+        summary.Add ("mixTxBytes", sent);
+        summary.Add ("mixRxBytes", received);
+    }
+
+    static const uint16_t PORT = 9000;
+    // Above the streams red-fork.h gives the queue discs
+    static const int64_t FIRST_STREAM = 100;
+
+private:
+    std::string m_path;
+    std::string m_rate;
+    std::string m_classList;
+    SizeDistribution m_sizes;
+    std::vector<uint32_t> m_classes;
+    uint32_t m_nSources;
+    std::vector<Ptr<SizeMixSource> > m_sources;
+    ApplicationContainer m_sinks;
+};
+
+} // namespace ns3
+
+#endif /* RED_SIZE_MIX_H */
@@ -0,0 +1,233 @@
+/** Per-packet queueing delay (sojourn time)
+ *
+ * ns-3.27 QueueDiscItems carry no timestamp, and a packet tag would cost
+ * an allocation and a tag-list walk per packet. SojournStamps keeps the
+ * enqueue time beside the packet instead: an open-addressing table keyed
+ * by packet uid (linear probing, backward-shift deletion, power-of-two
+ * size), filled on the Enqueue trace and emptied on Dequeue or Drop. It
+ * never holds more entries than packets queued, so after warm-up a packet
+ * costs two probes and no allocation.
+ *
+ * DelayHistogram is HDR-style: values below 2^subBits nanoseconds get one
+ * bucket each, every power of two above that is split into 2^subBits
+ * buckets. Recording is a count-leading-zeros and an increment; quantiles
+ * are exact to within 2^-subBits relative (0.8 % at the default 7).
+ * Buckets are allocated up to the largest delay seen, so a histogram of
+ * sub-second delays takes a few kB.
+ */
+
+#ifndef RED_SOJOURN_H
+#define RED_SOJOURN_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+namespace ns3 {
+
+class DelayHistogram
+{
+public:
+    explicit DelayHistogram (uint32_t subBits = 7)
+      : m_subBits (subBits),
+        m_count (0),
+        m_max (0)
+    {
+    }
+
+    void Record (uint64_t ns)
+    {
+        uint32_t index = Index (ns);
+        if (index >= m_counts.size ())
+            m_counts.resize (index + 1, 0);
+        m_counts[index]++;
+        m_count++;
+        if (ns > m_max)
+            m_max = ns;
+    }
+
+    void Reset ()
+    {
+        m_counts.clear ();
+        m_count = 0;
+        m_max = 0;
+    }
+
+    // Adds the samples of other, which must have the same subBits
+    void Merge (const DelayHistogram &other)
+    {
+        if (other.m_counts.size () > m_counts.size ())
+            m_counts.resize (other.m_counts.size (), 0);
+        for (size_t i = 0; i < other.m_counts.size (); ++i)
+            m_counts[i] += other.m_counts[i];
+        m_count += other.m_count;
+        m_max = std::max (m_max, other.m_max);
+    }
+
+    uint64_t GetCount () const
+    {
+        return m_count;
+    }
+
+    // Seconds
+    double GetMax () const
+    {
+        return m_max * 1e-9;
+    }
+
+    // Smallest recorded delay d, in seconds, with at least q of the samples
+    // <= d; reported as the middle of its bucket
+    double Quantile (double q) const
+    {
+        if (m_count == 0)
+            return 0.0;
+        uint64_t rank = static_cast<uint64_t> (std::ceil (q * m_count));
+        if (rank == 0)
+            rank = 1;
+        uint64_t seen = 0;
+        for (uint32_t i = 0; i < m_counts.size (); ++i)
+        {
+            seen += m_counts[i];
+            if (seen >= rank)
+                return std::min (Middle (i), static_cast<double> (m_max)) * 1e-9;
+        }
+        return GetMax ();
+    }
+
+private:
+    uint32_t Index (uint64_t ns) const
+    {
+        uint64_t sub = 1ULL << m_subBits;
+        if (ns < sub)
+            return ns;
+        uint32_t shift = 63 - __builtin_clzll (ns) - m_subBits;
+        return (shift + 1) * sub + ((ns >> shift) - sub);
+    }
+
+    double Middle (uint32_t index) const
+    {
+        uint64_t sub = 1ULL << m_subBits;
+        if (index < sub)
+            return index;
+        uint32_t shift = index / sub - 1;
+        uint64_t low = (index % sub + sub) << shift;
+        return low + ((1ULL << shift) - 1) / 2.0;
+    }
+
+    uint32_t m_subBits;
+    std::vector<uint64_t> m_counts;
+    uint64_t m_count;
+    uint64_t m_max;
+};
+
+class SojournStamps
+{
+public:
+    SojournStamps ()
+      : m_slots (1024),
+        m_mask (1023),
+        m_size (0)
+    {
+        for (size_t i = 0; i < m_slots.size (); ++i)
+            m_slots[i].uid = EMPTY;
+    }
+
+    void Insert (uint64_t uid, int64_t ns, uint32_t flow)
+    {
+        if (2 * (m_size + 1) > m_slots.size ())
+            Grow ();
+        uint64_t i = Home (uid);
+        while (m_slots[i].uid != EMPTY && m_slots[i].uid != uid)
+            i = (i + 1) & m_mask;
+        if (m_slots[i].uid == EMPTY)
+            m_size++;
+        m_slots[i].uid = uid;
+        m_slots[i].ns = ns;
+        m_slots[i].flow = flow;
+    }
+
+    // Removes uid; returns false when it was not stamped
+    bool Take (uint64_t uid, int64_t &ns, uint32_t &flow)
+    {
+        uint64_t i = Home (uid);
+        while (m_slots[i].uid != uid)
+        {
+            if (m_slots[i].uid == EMPTY)
+                return false;
+            i = (i + 1) & m_mask;
+        }
+        ns = m_slots[i].ns;
+        flow = m_slots[i].flow;
+        Erase (i);
+        return true;
+    }
+
+    uint64_t GetSize () const
+    {
+        return m_size;
+    }
+
+private:
+    static const uint64_t EMPTY = ~0ULL;
+
+    struct Slot
+    {
+        uint64_t uid;
+        int64_t ns;
+        uint32_t flow;
+    };
+
+    uint64_t Home (uint64_t uid) const
+    {
+        return (uid * 0x9e3779b97f4a7c15ULL >> 20) & m_mask;
+    }
+
+    // Backward-shift deletion keeps every probe chain unbroken without tombstones
+    void Erase (uint64_t hole)
+    {
+        m_size--;
+        uint64_t i = hole;
+        while (true)
+        {
+            i = (i + 1) & m_mask;
+            if (m_slots[i].uid == EMPTY)
+                break;
+            uint64_t home = Home (m_slots[i].uid);
+            // Move i into the hole unless its home lies cyclically in (hole, i]
+            if (((i - home) & m_mask) >= ((i - hole) & m_mask))
+            {
+                m_slots[hole] = m_slots[i];
+                hole = i;
+            }
+        }
+        m_slots[hole].uid = EMPTY;
+    }
+
+    void Grow ()
+    {
+        std::vector<Slot> old;
+        old.swap (m_slots);
+        m_slots.resize (2 * old.size ());
+        m_mask = m_slots.size () - 1;
+        for (size_t i = 0; i < m_slots.size (); ++i)
+            m_slots[i].uid = EMPTY;
+        for (size_t i = 0; i < old.size (); ++i)
+        {
+            if (old[i].uid == EMPTY)
+                continue;
+            uint64_t j = Home (old[i].uid);
+            while (m_slots[j].uid != EMPTY)
+                j = (j + 1) & m_mask;
+            m_slots[j] = old[i];
+        }
+    }
+
+    std::vector<Slot> m_slots;
+    uint64_t m_mask;
+    uint64_t m_size;
+};
+
+} // namespace ns3
+
+#endif /* RED_SOJOURN_H */
@@ -0,0 +1,65 @@
+/** Reads the few TCP fields the traces need without a TcpHeader
+ *
+ * PeekHeader (TcpHeader&) deserializes the whole header including every
+ * option, to end up using the ports and the sequence number. PeekTcp ()
+ * copies the first 13 bytes of the segment out of the packet buffer and
+ * decodes just those fields. Packets in a queue disc item start at the
+ * transport header (the IPv4 header is kept in the item), so offset 0 is
+ * the TCP source port. The item overload reads only IPv4 items whose
+ * protocol is TCP: a UDP datagram (red-size-mix.h) of 20 bytes or more
+ * would otherwise pass as a segment, its length and checksum read as the
+ * sequence number.
+ *
+ * red-peek-bench.cc measures both paths.
+ */
+
+#ifndef RED_TCP_PEEK_H
+#define RED_TCP_PEEK_H
+
+#include <cstdint>
+
+#include "ns3/network-module.h"
+#include "ns3/internet-module.h"
+#include "ns3/traffic-control-module.h"
+
+namespace ns3 {
+
+struct TcpFields
+{
+    uint16_t sourcePort;
+    uint16_t destinationPort;
+    uint32_t sequence;
+    uint32_t headerLength;   // bytes, options included
+    uint32_t payloadLength;  // bytes after the TCP header
+};
+
+// Returns false when the packet is too short to hold a TCP header
+inline bool
+PeekTcp (const Ptr<const Packet> &packet, TcpFields &fields)
+{
+    uint8_t b[13];
+    uint32_t size = packet->GetSize ();
+    if (size < 20 || packet->CopyData (b, sizeof (b)) != sizeof (b))
+        return false;
+
+    fields.sourcePort = static_cast<uint16_t> (b[0] << 8 | b[1]);
+    fields.destinationPort = static_cast<uint16_t> (b[2] << 8 | b[3]);
+    fields.sequence = static_cast<uint32_t> (b[4]) << 24 | b[5] << 16 | b[6] << 8 | b[7];
+    fields.headerLength = (b[12] >> 4) * 4u;
+    fields.payloadLength = size > fields.headerLength ? size - fields.headerLength : 0;
+    return true;
+}
+
+// Returns false as well for anything but an IPv4 TCP segment
+inline bool
+PeekTcp (const Ptr<const QueueDiscItem> &item, TcpFields &fields)
+{
+    Ptr<const Ipv4QueueDiscItem> ipItem = DynamicCast<const Ipv4QueueDiscItem> (item);
+    if (!ipItem || ipItem->GetHeader ().GetProtocol () != TcpL4Protocol::PROT_NUMBER)
+        return false;
+    return PeekTcp (item->GetPacket (), fields);
+}
+
+} // namespace ns3
+
+#endif /* RED_TCP_PEEK_H */
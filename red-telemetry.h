@@ -0,0 +1,411 @@
+/** Live telemetry while a scenario runs
+ *
+ * --telemetry=<port> or --telemetry=<path> makes a scenario listen on
+ * localhost TCP or on a Unix socket. Every --telemetryInterval simulated
+ * seconds the simulator thread copies a handful of numbers per queue and
+ * per sink into a snapshot, under a mutex and without formatting
+ * anything. A server thread formats the newest snapshot and sends it to
+ * every connected client, at most every 100 ms of wall-clock time:
+ *
+ *   S <simTime> <wallSeconds> <queues> <sinks>
+ *   Q <index> <name> <length> <average> <drops>     per monitored queue
+ *   R <index> <bytes>                               per PacketSink
+ *   E
+ *
+ * average is the RED-style EWMA of QueueStats, '-' stands for an unnamed
+ * queue. A client that sends the line "stop" ends the run at the next
+ * snapshot, as if the stop time had been reached; the summary then
+ * carries stoppedEarly. Clients that cannot keep up are disconnected
+ * instead of slowing the simulation down. For example
+ *
+ *   ./waf --run "p2c --telemetry=9000 --stopTime=3600" &
+ *   nc localhost 9000
+ *
+ * Sockets are never touched by the simulator thread.
+ */
+
+#ifndef RED_TELEMETRY_H
+#define RED_TELEMETRY_H
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "ns3/core-module.h"
+#include "ns3/applications-module.h"
+
+#include "red-profile.h"
+#include "red-queue-monitor.h"
+#include "red-run-summary.h"
+
+namespace ns3 {
+
+struct TelemetrySnapshot
+{
+    struct Queue
+    {
+        std::string name;
+        uint32_t length;
+        double average;
+        uint64_t drops;
+    };
+
+    double simTime = 0;
+    double wallSeconds = 0;
+    std::vector<Queue> queues;
+    std::vector<uint64_t> rx;
+};
+
+// The sockets and the sending thread; knows nothing about the simulation
+class TelemetryServer
+{
+public:
+    TelemetryServer ()
+      : m_listen (-1),
+        m_stop (false),
+        m_stopRequested (false),
+        m_version (0),
+        m_clients (0)
+    {
+    }
+
+    ~TelemetryServer ()
+    {
+        Close ();
+    }
+
+    TelemetryServer (const TelemetryServer &) = delete;
+    TelemetryServer &operator= (const TelemetryServer &) = delete;
+
+    // address is a TCP port on 127.0.0.1 or a Unix socket path; starts the
+    // server thread
+    bool Open (const std::string &address, std::string &error)
+    {
+        bool isPort = !address.empty () && address.find_first_not_of ("0123456789") == std::string::npos;
+        m_listen = socket (isPort ? AF_INET : AF_UNIX, SOCK_STREAM, 0);
+        if (m_listen < 0)
+        {
+            error = "telemetry: cannot create a socket";
+            return false;
+        }
+        int rc;
+        if (isPort)
+        {
+            int one = 1;
+            setsockopt (m_listen, SOL_SOCKET, SO_REUSEADDR, &one, sizeof (one));
+            sockaddr_in sa;
+            std::memset (&sa, 0, sizeof (sa));
+            sa.sin_family = AF_INET;
+            sa.sin_port = htons (static_cast<uint16_t> (std::stoi (address)));
+            sa.sin_addr.s_addr = htonl (INADDR_LOOPBACK);
+            rc = bind (m_listen, reinterpret_cast<sockaddr *> (&sa), sizeof (sa));
+        }
+        else
+        {
+            sockaddr_un sa;
+            std::memset (&sa, 0, sizeof (sa));
+            sa.sun_family = AF_UNIX;
+            std::strncpy (sa.sun_path, address.c_str (), sizeof (sa.sun_path) - 1);
+            unlink (address.c_str ());
+            m_path = address;
+            rc = bind (m_listen, reinterpret_cast<sockaddr *> (&sa), sizeof (sa));
+        }
+        if (rc < 0 || listen (m_listen, 8) < 0)
+        {
+            error = "telemetry: cannot listen on " + address + ": " + std::strerror (errno);
+            close (m_listen);
+            m_listen = -1;
+            return false;
+        }
+        fcntl (m_listen, F_SETFL, O_NONBLOCK);
+        m_stop = false;
+        m_thread = std::thread (&TelemetryServer::Serve, this);
+        return true;
+    }
+
+    bool IsOpen () const
+    {
+        return m_listen >= 0;
+    }
+
+    // Simulator side: replaces the snapshot the thread sends next
+    void Publish (const TelemetrySnapshot &snapshot)
+    {
+        std::lock_guard<std::mutex> lock (m_mutex);
+        m_snapshot = snapshot;
+        m_version++;
+    }
+
+    // A client asked to end the run
+    bool IsStopRequested () const
+    {
+        return m_stopRequested.load (std::memory_order_relaxed);
+    }
+
+    uint32_t GetClients () const
+    {
+        return m_clients.load (std::memory_order_relaxed);
+    }
+
+    // Sends the last snapshot, disconnects everyone and joins the thread
+    void Close ()
+    {
+        if (m_listen < 0)
+            return;
+        m_stop = true;
+        m_thread.join ();
+        close (m_listen);
+        m_listen = -1;
+        if (!m_path.empty ())
+            unlink (m_path.c_str ());
+    }
+
+private:
+    void Serve ()
+    {
+        std::vector<int> clients;
+        std::string input;
+        uint64_t sent = 0;
+        std::chrono::steady_clock::time_point lastSend;
+        const std::chrono::milliseconds gap (100);
+
+        for (;;)
+        {
+            bool stopping = m_stop.load ();
+            std::vector<pollfd> fds (1 + clients.size ());
+            fds[0].fd = m_listen;
+            fds[0].events = POLLIN;
+            for (size_t i = 0; i < clients.size (); ++i)
+            {
+                fds[i + 1].fd = clients[i];
+                fds[i + 1].events = POLLIN;
+            }
+            poll (fds.data (), fds.size (), stopping ? 0 : 20);
+
+            if (fds[0].revents & POLLIN)
+            {
+                int fd;
+                while ((fd = accept (m_listen, nullptr, nullptr)) >= 0)
+                {
+                    fcntl (fd, F_SETFL, O_NONBLOCK);
+                    clients.push_back (fd);
+                }
+            }
+            for (size_t i = fds.size () - 1; i >= 1; --i)
+            {
+                if (!(fds[i].revents & (POLLIN | POLLHUP | POLLERR)))
+                    continue;
+                char buf[256];
+                ssize_t n = recv (fds[i].fd, buf, sizeof (buf), 0);
+                if (n <= 0)
+                {
+                    Drop (clients, fds[i].fd);
+                    continue;
+                }
+                input.append (buf, n);
+                if (input.find ("stop") != std::string::npos)
+                    m_stopRequested.store (true, std::memory_order_relaxed);
+                if (input.size () > 64)
+                    input.erase (0, input.size () - 8);
+            }
+            m_clients.store (clients.size (), std::memory_order_relaxed);
+
+            std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now ();
+            if (!clients.empty () && (stopping || now - lastSend >= gap))
+            {
+                TelemetrySnapshot snapshot;
+                uint64_t version;
+                {
+                    std::lock_guard<std::mutex> lock (m_mutex);
+                    version = m_version;
+                    if (version != sent)
+                        snapshot = m_snapshot;
+                }
+                if (version != sent)
+                {
+                    std::string text = Format (snapshot);
+                    for (size_t i = clients.size (); i-- > 0;)
+                    {
+                        ssize_t n = send (clients[i], text.data (), text.size (), MSG_NOSIGNAL | MSG_DONTWAIT);
+                        if (n != static_cast<ssize_t> (text.size ()))
+                            Drop (clients, clients[i]);
+                    }
+                    sent = version;
+                    lastSend = now;
+                }
+            }
+
+            if (stopping)
+                break;
+        }
+        for (int fd : clients)
+            close (fd);
+        m_clients.store (0, std::memory_order_relaxed);
+    }
+
+    static void Drop (std::vector<int> &clients, int fd)
+    {
+        close (fd);
+        for (size_t i = 0; i < clients.size (); ++i)
+        {
+            if (clients[i] == fd)
+            {
+                clients.erase (clients.begin () + i);
+                return;
+            }
+        }
+    }
+
+    static std::string Format (const TelemetrySnapshot &s)
+    {
+        std::string text;
+        char line[160];
+        std::snprintf (line, sizeof (line), "S %.6f %.3f %u %u\n", s.simTime, s.wallSeconds,
+                       static_cast<uint32_t> (s.queues.size ()), static_cast<uint32_t> (s.rx.size ()));
+        text += line;
+        for (size_t i = 0; i < s.queues.size (); ++i)
+        {
+            const TelemetrySnapshot::Queue &q = s.queues[i];
+            std::snprintf (line, sizeof (line), "Q %u %s %u %.4f %llu\n", static_cast<uint32_t> (i),
+                           q.name.empty () ? "-" : q.name.c_str (), q.length, q.average, (unsigned long long) q.drops);
+            text += line;
+        }
+        for (size_t i = 0; i < s.rx.size (); ++i)
+        {
+            std::snprintf (line, sizeof (line), "R %u %llu\n", static_cast<uint32_t> (i), (unsigned long long) s.rx[i]);
+            text += line;
+        }
+        text += "E\n";
+        return text;
+    }
+
+    int m_listen;
+    std::string m_path;
+    std::thread m_thread;
+    std::atomic<bool> m_stop;
+    std::atomic<bool> m_stopRequested;
+    std::mutex m_mutex;
+    TelemetrySnapshot m_snapshot;
+    uint64_t m_version;
+    std::atomic<uint32_t> m_clients;
+};
+
+// Feeds a TelemetryServer from a QueueMonitor and the sinks of a scenario
+class QueueTelemetry
+{
+public:
+    QueueTelemetry ()
+      : m_monitor (nullptr),
+        m_stoppedEarly (false)
+    {
+    }
+
+    bool Open (const std::string &address, std::string &error)
+    {
+        return m_server.Open (address, error);
+    }
+
+    bool IsOpen () const
+    {
+        return m_server.IsOpen ();
+    }
+
+    // Publishes a snapshot every interval from now on
+    void Start (const QueueMonitor &monitor, const ApplicationContainer &sinks, Time interval)
+    {
+        m_monitor = &monitor;
+        m_sinks = sinks;
+        m_interval = interval;
+        m_wallStart = std::chrono::steady_clock::now ();
+        Simulator::ScheduleNow (&QueueTelemetry::Sample, this);
+    }
+
+    // Publishes the final state and closes the server; call after Simulator::Run ()
+    void Stop ()
+    {
+        if (!m_server.IsOpen ())
+            return;
+        Fill ();
+        m_server.Publish (m_snapshot);
+        m_server.Close ();
+    }
+
+    // Whether a client ended the run before its stop time
+    bool IsStoppedEarly () const
+    {
+        return m_stoppedEarly;
+    }
+
+    void Report (RunSummary &summary) const
+    {
+        summary.Add ("stoppedEarly", m_stoppedEarly);
+    }
+
+private:
+    static CallbackTimer &Timer ()
+    {
+        static CallbackTimer timer ("Telemetry");
+        return timer;
+    }
+
+    void Fill ()
+    {
+        double now = Simulator::Now ().GetSeconds ();
+        m_snapshot.simTime = now;
+        m_snapshot.wallSeconds = SecondsSince (m_wallStart);
+        m_snapshot.queues.resize (m_monitor->GetN ());
+        for (uint32_t i = 0; i < m_monitor->GetN (); ++i)
+        {
+            const QueueMonitor::Queue &q = m_monitor->Get (i);
+            TelemetrySnapshot::Queue &s = m_snapshot.queues[i];
+            s.name = q.name;
+            s.length = QueueMonitor::Length (q);
+            s.average = q.stats.GetEwma ();
+            s.drops = q.drops;
+        }
+        m_snapshot.rx.resize (m_sinks.GetN ());
+        for (uint32_t i = 0; i < m_sinks.GetN (); ++i)
+            m_snapshot.rx[i] = DynamicCast<PacketSink> (m_sinks.Get (i))->GetTotalRx ();
+    }
+
+    void Sample ()
+    {
+        TimedScope timed (Timer ());
+        Fill ();
+        m_server.Publish (m_snapshot);
+        if (m_server.IsStopRequested ())
+        {
+            m_stoppedEarly = true;
+            Simulator::Stop ();
+            return;
+        }
+        Simulator::Schedule (m_interval, &QueueTelemetry::Sample, this);
+    }
+
+    TelemetryServer m_server;
+    const QueueMonitor *m_monitor;
+    ApplicationContainer m_sinks;
+    Time m_interval;
+    std::chrono::steady_clock::time_point m_wallStart;
+    TelemetrySnapshot m_snapshot;
+    bool m_stoppedEarly;
+};
+
+} // namespace ns3
+
+#endif /* RED_TELEMETRY_H */
@@ -0,0 +1,471 @@
+/** Buffered trace sink for the RED scenarios
+ *
+ * A TraceFileWriter keeps its output file open for the whole run and
+ * appends records to a large in-memory buffer that is written out in big
+ * chunks, instead of opening, writing one line and closing the file on
+ * every packet.
+ *
+ * Three formats are supported:
+ *  - TEXT:     the same whitespace separated lines the .plot files always
+ *              had, so plotp2a.py / plotp2c.py keep working unchanged.
+ *  - BINARY:   a small header followed by fixed-width native-endian records.
+ *              Packet records are (time, seq, port, queue id), sample
+ *              records are (time, value).
+ *  - COLUMNAR: delta/varint encoded column blocks (red-columnar.h), only
+ *              the columns the TEXT layout would print.
+ * ExportText() turns a BINARY or COLUMNAR file back into the TEXT layout
+ * after the run.
+ */
+
+#ifndef RED_TRACE_WRITER_H
+#define RED_TRACE_WRITER_H
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "red-columnar.h"
+
+namespace ns3 {
+
+struct TracePacketRecord
+{
+    double time;
+    uint32_t seq;
+    uint16_t port;
+    uint16_t queue;
+};
+
+struct TraceSampleRecord
+{
+    double time;
+    double value;
+};
+
+static_assert (sizeof (TracePacketRecord) == 16, "packet records must stay fixed width");
+static_assert (sizeof (TraceSampleRecord) == 16, "sample records must stay fixed width");
+
+class TraceFileWriter
+{
+public:
+    enum Format
+    {
+        TEXT,
+        BINARY,
+        COLUMNAR
+    };
+
+    enum Kind
+    {
+        PACKET = 1,
+        SAMPLE = 2
+    };
+
+    // Columns printed after the timestamp in TEXT mode (packet records only)
+    enum Column
+    {
+        COL_SEQ = 1,
+        COL_PORT = 2,
+        COL_QUEUE = 4
+    };
+
+    struct FileHeader
+    {
+        char magic[4];
+        uint16_t version;
+        uint16_t kind;
+        uint32_t columns;
+        uint32_t recordSize;
+    };
+
+    TraceFileWriter ()
+      : m_file (nullptr),
+        m_format (TEXT),
+        m_kind (PACKET),
+        m_columns (0),
+        m_used (0),
+        m_records (0),
+        m_inBuffer (0),
+        m_onDisk (0),
+        m_failed (false)
+    {
+    }
+
+    ~TraceFileWriter ()
+    {
+        Close ();
+    }
+
+    // Lets writers live in a growable array; the source is left closed
+    TraceFileWriter (TraceFileWriter &&other)
+      : m_file (other.m_file),
+        m_path (std::move (other.m_path)),
+        m_format (other.m_format),
+        m_kind (other.m_kind),
+        m_columns (other.m_columns),
+        m_buffer (std::move (other.m_buffer)),
+        m_used (other.m_used),
+        m_records (other.m_records),
+        m_inBuffer (other.m_inBuffer),
+        m_onDisk (other.m_onDisk),
+        m_failed (other.m_failed),
+        m_block (std::move (other.m_block)),
+        m_encoded (std::move (other.m_encoded))
+    {
+        other.m_file = nullptr;
+        other.m_used = 0;
+    }
+
+    TraceFileWriter (const TraceFileWriter &) = delete;
+    TraceFileWriter &operator= (const TraceFileWriter &) = delete;
+
+    // false for anything but text, binary and columnar
+    static bool ParseFormat (const std::string &name, Format &format)
+    {
+        if (name == "text")
+            format = TEXT;
+        else if (name == "binary")
+            format = BINARY;
+        else if (name == "columnar")
+            format = COLUMNAR;
+        else
+            return false;
+        return true;
+    }
+
+    static std::string Extension (Format format)
+    {
+        if (format == BINARY)
+            return ".bin";
+        return format == COLUMNAR ? ".rcol" : ".plot";
+    }
+
+    // Truncates path and starts a new trace. bufferSize is the chunk size
+    // handed to fwrite; records are never split across the buffer end.
+    bool Open (const std::string &path, Format format, Kind kind, uint32_t columns = 0,
+               size_t bufferSize = 1 << 20)
+    {
+        Close ();
+        m_file = std::fopen (path.c_str (), "wb");
+        if (!m_file)
+            return false;
+        std::setvbuf (m_file, nullptr, _IONBF, 0);
+        m_path = path;
+        m_format = format;
+        m_kind = kind;
+        m_columns = columns;
+        m_buffer.resize (bufferSize < 4096 ? 4096 : bufferSize);
+        m_used = 0;
+        m_records = 0;
+        m_inBuffer = 0;
+        m_onDisk = 0;
+        m_failed = false;
+
+        if (m_format == BINARY)
+        {
+            FileHeader header = MakeHeader (kind, columns);
+            Append (&header, sizeof (header));
+        }
+        else if (m_format == COLUMNAR)
+        {
+            std::vector<std::string> names = ColumnNames (kind, columns);
+            Columnar::FileHeader header = {{'R', 'C', 'O', 'L'}, 1, static_cast<uint16_t> (kind), columns,
+                                           static_cast<uint32_t> (names.size ())};
+            Append (&header, sizeof (header));
+            for (size_t c = 0; c < names.size (); ++c)
+            {
+                Columnar::ColumnInfo info;
+                std::memset (&info, 0, sizeof (info));
+                std::strncpy (info.name, names[c].c_str (), sizeof (info.name));
+                Append (&info, sizeof (info));
+            }
+            m_block.Reset (names.size ());
+        }
+        return true;
+    }
+
+    bool IsOpen () const
+    {
+        return m_file != nullptr;
+    }
+
+    Kind GetKind () const
+    {
+        return m_kind;
+    }
+
+    const std::string &GetPath () const
+    {
+        return m_path;
+    }
+
+    uint64_t GetRecordCount () const
+    {
+        return m_records;
+    }
+
+    // Records that did not reach the file because a write came up short,
+    // e.g. on a full disk; complete once the file is closed. A short write
+    // tears the file, so everything after it is dropped too.
+    uint64_t GetLost () const
+    {
+        return m_records - m_onDisk;
+    }
+
+    void WritePacket (double time, uint32_t seq, uint16_t port, uint16_t queue)
+    {
+        if (!m_file)
+            return;
+        m_records++;
+        if (m_format == BINARY)
+        {
+            TracePacketRecord r = {time, seq, port, queue};
+            Append (&r, sizeof (r));
+            m_inBuffer++;
+            return;
+        }
+        if (m_format == COLUMNAR)
+        {
+            double row[4] = {time};
+            int n = 1;
+            if (m_columns & COL_SEQ)
+                row[n++] = seq;
+            if (m_columns & COL_PORT)
+                row[n++] = port;
+            if (m_columns & COL_QUEUE)
+                row[n++] = queue;
+            if (m_block.Add (row))
+                EncodeBlock ();
+            return;
+        }
+        Reserve (kMaxLine);
+        m_used += FormatPacket (&m_buffer[m_used], time, seq, port, queue, m_columns);
+        m_inBuffer++;
+    }
+
+    void WriteSample (double time, double value)
+    {
+        if (!m_file)
+            return;
+        m_records++;
+        if (m_format == BINARY)
+        {
+            TraceSampleRecord r = {time, value};
+            Append (&r, sizeof (r));
+            m_inBuffer++;
+            return;
+        }
+        if (m_format == COLUMNAR)
+        {
+            double row[2] = {time, value};
+            if (m_block.Add (row))
+                EncodeBlock ();
+            return;
+        }
+        Reserve (kMaxLine);
+        m_used += FormatSample (&m_buffer[m_used], time, value);
+        m_inBuffer++;
+    }
+
+    void Flush ()
+    {
+        if (!m_file || m_used == 0)
+            return;
+        if (!m_failed && std::fwrite (m_buffer.data (), 1, m_used, m_file) != m_used)
+            m_failed = true;
+        if (!m_failed)
+            m_onDisk += m_inBuffer;
+        m_used = 0;
+        m_inBuffer = 0;
+    }
+
+    void Close ()
+    {
+        if (!m_file)
+            return;
+        if (m_format == COLUMNAR && m_block.GetRows () > 0)
+            EncodeBlock ();
+        Flush ();
+        std::fclose (m_file);
+        m_file = nullptr;
+    }
+
+    // Converts a BINARY or COLUMNAR trace into the TEXT layout it would have had
+    static bool ExportText (const std::string &binPath, const std::string &textPath)
+    {
+        FILE *in = std::fopen (binPath.c_str (), "rb");
+        if (!in)
+            return false;
+        FileHeader header;
+        if (std::fread (&header, sizeof (header), 1, in) != 1)
+        {
+            std::fclose (in);
+            return false;
+        }
+        if (std::memcmp (header.magic, "RCOL", 4) == 0)
+        {
+            std::fclose (in);
+            return ExportColumnarText (binPath, textPath);
+        }
+        if (std::memcmp (header.magic, "REDT", 4) != 0)
+        {
+            std::fclose (in);
+            return false;
+        }
+
+        TraceFileWriter out;
+        if (!out.Open (textPath, TEXT, static_cast<Kind> (header.kind), header.columns))
+        {
+            std::fclose (in);
+            return false;
+        }
+
+        if (header.kind == PACKET)
+        {
+            TracePacketRecord r;
+            while (std::fread (&r, sizeof (r), 1, in) == 1)
+                out.WritePacket (r.time, r.seq, r.port, r.queue);
+        }
+        else
+        {
+            TraceSampleRecord r;
+            while (std::fread (&r, sizeof (r), 1, in) == 1)
+                out.WriteSample (r.time, r.value);
+        }
+        std::fclose (in);
+        out.Close ();
+        return true;
+    }
+
+    // Columns a COLUMNAR file stores: time plus what TEXT would print
+    static std::vector<std::string> ColumnNames (Kind kind, uint32_t columns)
+    {
+        std::vector<std::string> names (1, "time");
+        if (kind == SAMPLE)
+        {
+            names.push_back ("value");
+            return names;
+        }
+        if (columns & COL_SEQ)
+            names.push_back ("seq");
+        if (columns & COL_PORT)
+            names.push_back ("port");
+        if (columns & COL_QUEUE)
+            names.push_back ("queue");
+        return names;
+    }
+
+    static FileHeader MakeHeader (Kind kind, uint32_t columns)
+    {
+        FileHeader header;
+        std::memcpy (header.magic, "REDT", 4);
+        header.version = 1;
+        header.kind = static_cast<uint16_t> (kind);
+        header.columns = columns;
+        header.recordSize = kind == PACKET ? sizeof (TracePacketRecord) : sizeof (TraceSampleRecord);
+        return header;
+    }
+
+    // Text formatting matches the default std::ostream output of the old
+    // callbacks (%g with 6 significant digits).
+    static size_t FormatPacket (char *out, double time, uint32_t seq, uint16_t port, uint16_t queue,
+                                uint32_t columns)
+    {
+        int n = std::snprintf (out, kMaxLine, "%g", time);
+        if (columns & COL_SEQ)
+            n += std::snprintf (out + n, kMaxLine - n, " %u", seq);
+        if (columns & COL_PORT)
+            n += std::snprintf (out + n, kMaxLine - n, " %u", static_cast<unsigned> (port));
+        if (columns & COL_QUEUE)
+            n += std::snprintf (out + n, kMaxLine - n, " %u", static_cast<unsigned> (queue));
+        out[n++] = '\n';
+        return n;
+    }
+
+    static size_t FormatSample (char *out, double time, double value)
+    {
+        int n = std::snprintf (out, kMaxLine, "%g %g\n", time, value);
+        return n;
+    }
+
+    static const size_t kMaxLine = 96;
+
+private:
+    void Reserve (size_t bytes)
+    {
+        if (m_used + bytes > m_buffer.size ())
+            Flush ();
+    }
+
+    // Everything goes through the buffer, so Flush () sees every write; a
+    // block larger than the buffer grows it
+    void Append (const void *data, size_t bytes)
+    {
+        Reserve (bytes);
+        if (bytes > m_buffer.size ())
+            m_buffer.resize (bytes);
+        std::memcpy (&m_buffer[m_used], data, bytes);
+        m_used += bytes;
+    }
+
+    void EncodeBlock ()
+    {
+        uint64_t rows = m_block.GetRows ();
+        m_encoded.clear ();
+        m_block.Encode (m_encoded);
+        Append (m_encoded.data (), m_encoded.size ());
+        m_inBuffer += rows;
+    }
+
+    static bool ExportColumnarText (const std::string &path, const std::string &textPath)
+    {
+        ColumnarReader reader;
+        if (!reader.Load (path))
+            return false;
+        Kind kind = static_cast<Kind> (reader.GetKind ());
+        uint32_t columns = reader.GetTextColumns ();
+        TraceFileWriter out;
+        if (!out.Open (textPath, TEXT, kind, columns))
+            return false;
+
+        const std::vector<double> &time = reader.Get ("time");
+        if (kind == SAMPLE)
+        {
+            const std::vector<double> &value = reader.Get ("value");
+            for (size_t i = 0; i < time.size (); ++i)
+                out.WriteSample (time[i], value[i]);
+        }
+        else
+        {
+            const std::vector<double> &seq = reader.Get ("seq");
+            const std::vector<double> &port = reader.Get ("port");
+            const std::vector<double> &queue = reader.Get ("queue");
+            for (size_t i = 0; i < time.size (); ++i)
+                out.WritePacket (time[i], seq.empty () ? 0 : seq[i], port.empty () ? 0 : port[i],
+                                 queue.empty () ? 0 : queue[i]);
+        }
+        out.Close ();
+        return true;
+    }
+
+    FILE *m_file;
+    std::string m_path;
+    Format m_format;
+    Kind m_kind;
+    uint32_t m_columns;
+    std::vector<char> m_buffer;
+    size_t m_used;
+    uint64_t m_records;
+    uint64_t m_inBuffer;   // records whose bytes wait in m_buffer
+    uint64_t m_onDisk;
+    bool m_failed;
+    ColumnarBlockWriter m_block;
+    std::vector<uint8_t> m_encoded;
+};
+
+} // namespace ns3
+
+#endif /* RED_TRACE_WRITER_H */
@@ -0,0 +1,400 @@
+/** Bursty and heavy-tailed workloads
+ *
+ * Every source used to be an always-on OnOff firehose, and a run was
+ * judged by the bytes its sinks received. A workload spec picks what a
+ * source sends instead, "<kind> [key=value ...]":
+ *
+ *   bulk                       constant OnOff at the source rate (the default)
+ *   pareto  on=0.5 off=0.5 shape=1.5
+ *                              OnOff at the source rate with Pareto on and
+ *                              off periods of these means (seconds)
+ *   poisson flows=100 size=100000 shape=1.2 maxSize=1e8
+ *                              Poisson arrivals of flows/s finite TCP flows,
+ *                              Pareto sizes of this mean (bytes), cut at maxSize
+ *   incast  period=0.1 size=20000 phase=0
+ *                              a flow of size bytes at phase + k * period;
+ *                              every incast source towards a node fires at
+ *                              the same instants
+ *
+ * --workload sets the spec of every source of p2a/p2b/p2c; red-scenario
+ * takes it per flow line (workload=poisson flows=50 ...) and uses
+ * --workload for the lines without one.
+ *
+ * A Pareto shape must be above 1, or its mean is infinite.
+ *
+ * The finite flows of poisson and incast are followed to their last byte
+ * at the sink by an FctTracker (red-fct.h), which reports their completion
+ * times per size bucket. Each of their sources draws from a fixed random
+ * stream (FIRST_STREAM + its index), so arrivals and sizes do not move
+ * when other random variables come or go.
+ */
+
+#ifndef RED_WORKLOAD_H
+#define RED_WORKLOAD_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <map>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/internet-module.h"
+#include "ns3/applications-module.h"
+
+#include "red-fct.h"
+#include "red-run-summary.h"
+
+namespace ns3 {
+
+struct WorkloadSpec
+{
+    std::string kind = "bulk";
+    std::map<std::string, std::string> options;
+
+    // "<kind> [key=value ...]"
+    bool Parse (const std::string &text, std::string &error)
+    {
+        std::istringstream in (text);
+        std::string token;
+        if (!(in >> kind))
+            kind = "bulk";
+        options.clear ();
+        while (in >> token)
+        {
+            std::string::size_type eq = token.find ('=');
+            if (eq == std::string::npos)
+            {
+                error = "workload '" + text + "': expected key=value, got '" + token + "'";
+                return false;
+            }
+            options[token.substr (0, eq)] = token.substr (eq + 1);
+        }
+        return Check (error);
+    }
+
+    // Whether kind and every option are known
+    bool Check (std::string &error) const
+    {
+        const char *keys;
+        if (kind == "bulk")
+            keys = " ";
+        else if (kind == "pareto")
+            keys = " on off shape ";
+        else if (kind == "poisson")
+            keys = " flows size shape maxSize ";
+        else if (kind == "incast")
+            keys = " period size phase ";
+        else
+        {
+            error = "unknown workload '" + kind + "' (bulk, pareto, poisson or incast)";
+            return false;
+        }
+        for (const std::pair<const std::string, std::string> &option : options)
+            if (std::string (keys).find (" " + option.first + " ") == std::string::npos)
+            {
+                error = "workload " + kind + " has no option '" + option.first + "'";
+                return false;
+            }
+        if ((kind == "pareto" || kind == "poisson") && Get ("shape", 1.5) <= 1)
+        {
+            error = "workload " + kind + ": shape must be above 1";
+            return false;
+        }
+        if (Get ("flows", 1) <= 0 || Get ("period", 1) <= 0)
+        {
+            error = "workload " + kind + ": flows and period must be positive";
+            return false;
+        }
+        return true;
+    }
+
+    double Get (const std::string &key, double fallback) const
+    {
+        std::map<std::string, std::string>::const_iterator it = options.find (key);
+        return it == options.end () ? fallback : std::atof (it->second.c_str ());
+    }
+
+    // poisson and incast send finite flows, whose completion is tracked
+    bool HasFlows () const
+    {
+        return kind == "poisson" || kind == "incast";
+    }
+};
+
+// Opens finite TCP flows towards one remote, at Poisson or periodic
+// (incast) instants
+class FlowArrivals : public Application
+{
+public:
+    static TypeId GetTypeId (void)
+    {
+        static TypeId tid = TypeId ("ns3::FlowArrivals")
+            .SetParent<Application> ()
+            .SetGroupName ("Applications")
+            .AddConstructor<FlowArrivals> ();
+        return tid;
+    }
+
+    FlowArrivals ()
+      : m_tracker (nullptr)
+    {
+        m_random = CreateObject<UniformRandomVariable> ();
+    }
+
+    void Setup (const WorkloadSpec &spec, Address remote, FctTracker *tracker, int64_t stream)
+    {
+        m_spec = spec;
+        m_remote = remote;
+        m_tracker = tracker;
+        m_random->SetStream (stream);
+    }
+
+protected:
+    virtual void DoDispose (void)
+    {
+        m_sending.clear ();
+        Application::DoDispose ();
+    }
+
+private:
+    virtual void StartApplication (void)
+    {
+        ScheduleNext ();
+    }
+
+    virtual void StopApplication (void)
+    {
+        Simulator::Cancel (m_next);
+    }
+
+    void ScheduleNext ()
+    {
+        double now = Simulator::Now ().GetSeconds ();
+        double wait;
+        if (m_spec.kind == "incast")
+        {
+            // The next multiple of the period, the same instant for every
+            // source with this period and phase
+            double period = m_spec.Get ("period", 0.1);
+            double phase = m_spec.Get ("phase", 0);
+            double k = std::floor ((now - phase) / period + 1e-9) + 1;
+            wait = std::max (0.0, phase + k * period - now);
+        }
+        else
+            wait = -std::log (1 - m_random->GetValue ()) / m_spec.Get ("flows", 100);
+        m_next = Simulator::Schedule (Seconds (wait), &FlowArrivals::Arrive, this);
+    }
+
+    // Pareto with the given mean: scale * (1 - u)^(-1/shape)
+    uint64_t DrawSize ()
+    {
+        double mean = m_spec.Get ("size", m_spec.kind == "incast" ? 20000 : 100000);
+        if (m_spec.kind == "incast")
+            return static_cast<uint64_t> (mean);
+        double shape = m_spec.Get ("shape", 1.2);
+        double scale = mean * (shape - 1) / shape;
+        double size = scale * std::pow (1 - m_random->GetValue (), -1 / shape);
+        return static_cast<uint64_t> (std::max (1.0, std::min (size, m_spec.Get ("maxSize", 1e8))));
+    }
+
+    void Arrive ()
+    {
+        Ptr<Socket> socket = Socket::CreateSocket (GetNode (), TcpSocketFactory::GetTypeId ());
+        Sending &flow = m_sending[socket];
+        flow.bytes = DrawSize ();
+        flow.left = flow.bytes;
+        flow.start = Simulator::Now ().GetSeconds ();
+        socket->Bind ();
+        socket->SetConnectCallback (MakeCallback (&FlowArrivals::Connected, this),
+                                    MakeCallback (&FlowArrivals::Failed, this));
+        socket->SetSendCallback (MakeCallback (&FlowArrivals::Fill, this));
+        socket->Connect (m_remote);
+        ScheduleNext ();
+    }
+
+    void Connected (Ptr<Socket> socket)
+    {
+        Sending &flow = m_sending[socket];
+        Address local;
+        socket->GetSockName (local);
+        m_tracker->Begin (local, flow.bytes, flow.start);
+        Fill (socket, socket->GetTxAvailable ());
+    }
+
+    void Failed (Ptr<Socket> socket)
+    {
+        m_sending.erase (socket);
+    }
+
+    // Hands the socket as much of the flow as its buffer takes; TCP sends
+    // the FIN once the buffer has drained
+    void Fill (Ptr<Socket> socket, uint32_t available)
+    {
+        std::map<Ptr<Socket>, Sending>::iterator it = m_sending.find (socket);
+        if (it == m_sending.end ())
+            return;
+        Sending &flow = it->second;
+        while (flow.left > 0 && available > 0)
+        {
+            uint32_t chunk = static_cast<uint32_t> (std::min<uint64_t> (flow.left, available));
+            int sent = socket->Send (Create<Packet> (chunk));
+            if (sent <= 0)
+                return;
+            flow.left -= sent;
+            available = socket->GetTxAvailable ();
+        }
+        if (flow.left == 0)
+        {
+            socket->Close ();
+            m_sending.erase (it);
+        }
+    }
+
+    struct Sending
+    {
+        uint64_t bytes;
+        uint64_t left;
+        double start;
+    };
+
+    WorkloadSpec m_spec;
+    Address m_remote;
+    FctTracker *m_tracker;
+    Ptr<UniformRandomVariable> m_random;
+    EventId m_next;
+    std::map<Ptr<Socket>, Sending> m_sending;
+};
+
+class Workload
+{
+public:
+    Workload ()
+      : m_text ("bulk"),
+        m_flows (false),
+        m_nSources (0)
+    {
+    }
+
+    void AddValues (CommandLine &cmd)
+    {
+        cmd.AddValue ("workload", "What every source sends: \"bulk\", \"pareto on=.. off=..\", \"poisson flows=.. size=..\" or \"incast period=.. size=..\" (see red-workload.h)", m_text);
+        m_fct.AddValues (cmd);
+    }
+
+    // Parses --workload and the tracker's values; lineRate is the
+    // bottleneck's, the default of the ideal completion time. Call after
+    // cmd.Parse ().
+    bool Parse (const std::string &lineRate, std::string &error)
+    {
+        m_fct.SetLineRate (lineRate);
+        return m_spec.Parse (m_text, error) && m_fct.Configure (error);
+    }
+
+    void SetLineRate (const std::string &lineRate)
+    {
+        m_fct.SetLineRate (lineRate);
+    }
+
+
+    const WorkloadSpec &GetSpec () const
+    {
+        return m_spec;
+    }
+
+    bool IsWritingFct () const
+    {
+        return m_fct.IsWriting ();
+    }
+
+    // Whether a source with finite flows was installed
+    bool HasFlows () const
+    {
+        return m_flows;
+    }
+
+    // Installs a --workload source on node sending to remote
+    ApplicationContainer Install (Ptr<Node> node, Address remote, const std::string &rate, uint32_t packetSize)
+    {
+        return Install (m_spec, node, remote, rate, packetSize);
+    }
+
+    // Installs a source of spec on node sending to remote; rate is the
+    // sending rate of bulk and pareto, packetSize their packet size
+    ApplicationContainer Install (const WorkloadSpec &spec, Ptr<Node> node, Address remote, const std::string &rate,
+                                  uint32_t packetSize)
+    {
+        if (spec.HasFlows ())
+        {
+            m_flows = true;
+            Ptr<FlowArrivals> source = CreateObject<FlowArrivals> ();
+            source->Setup (spec, remote, &m_fct, FIRST_STREAM + m_nSources++);
+            node->AddApplication (source);
+            return ApplicationContainer (source);
+        }
+
+        OnOffHelper sourceHelper ("ns3::TcpSocketFactory", remote);
+        if (spec.kind == "pareto")
+        {
+            double shape = spec.Get ("shape", 1.5);
+            std::ostringstream on;
+            std::ostringstream off;
+            on << "ns3::ParetoRandomVariable[Mean=" << spec.Get ("on", 0.5) << "|Shape=" << shape << "]";
+            off << "ns3::ParetoRandomVariable[Mean=" << spec.Get ("off", 0.5) << "|Shape=" << shape << "]";
+            sourceHelper.SetAttribute ("OnTime", StringValue (on.str ()));
+            sourceHelper.SetAttribute ("OffTime", StringValue (off.str ()));
+        }
+        else
+        {
+            sourceHelper.SetAttribute ("OnTime", StringValue ("ns3::ConstantRandomVariable[Constant=1]"));
+            sourceHelper.SetAttribute ("OffTime", StringValue ("ns3::ConstantRandomVariable[Constant=0]"));
+        }
+        sourceHelper.SetAttribute ("DataRate", DataRateValue (DataRate (rate)));
+        sourceHelper.SetAttribute ("PacketSize", UintegerValue (packetSize));
+        return sourceHelper.Install (node);
+    }
+
+    // Tracks the finite flows at sinks and opens fct.txt with --writeFct
+    bool Watch (const ApplicationContainer &sinks, const std::string &pathOut)
+    {
+        if (!m_flows)
+            return true;
+        m_fct.Watch (sinks);
+        return !m_fct.IsWriting () || m_fct.Open (pathOut + "/fct.txt");
+    }
+
+    void Restart ()
+    {
+        m_fct.Restart ();
+    }
+
+    void Finish (double stopTime)
+    {
+        m_fct.Finish (stopTime);
+    }
+
+    void Report (RunSummary &summary) const
+    {
+        if (m_flows)
+            m_fct.Report (summary);
+    }
+
+    // Above the streams of red-fork.h and the SizeMix sources
+    static const int64_t FIRST_STREAM = 1 << 20;
+
+private:
+    std::string m_text;
+    WorkloadSpec m_spec;
+    FctTracker m_fct;
+    bool m_flows;
+    uint32_t m_nSources;
+};
+
+} // namespace ns3
+
+#endif /* RED_WORKLOAD_H */
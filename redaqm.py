@@ -0,0 +1,138 @@
+#!/usr/bin/env python3
+"""Compares queue disciplines on the same scenario and seed.
+
+Runs a scenario program once per --aqm choice (red, ared, pie, codel,
+fqcodel, pfifo), all with the same runNumber and in parallel, and reports
+queueing delay percentiles against throughput, drops and ECN marks.
+red-ecn is RED with --ecn=1, marking instead of dropping, to compare with
+the drop-based red runs:
+
+    python3 redaqm.py --ns3-dir ~/ns-3.27 --program p2b --seeds 1 2 3
+    python3 redaqm.py --ns3-dir ~/ns-3.27 --program p2c --aqms red pie codel --plot aqm.png
+    python3 redaqm.py --ns3-dir ~/ns-3.27 --program p2a --aqms red red-ecn --seeds 1 2 3
+
+Every run measures per-packet sojourn times (--sojourn=1) and the delay
+columns are their percentiles (sojournP50Ms/P90Ms/P99Ms, the worst queue
+when a program has several). For a program without --sojourn the delay is
+estimated from the queue length percentiles times the transmission time of
+one packet on the bottleneck (linkBps and packetBytes in summary.txt).
+Every run is kept in <out>/aqm.csv; the printed table holds the mean over
+the seeds.
+"""
+
+import argparse
+import os
+import re
+import sys
+import time
+
+from redsweep import add_common_arguments, find_program, run_one, run_pool, write_table
+
+AQMS = ["red", "ared", "pie", "codel", "fqcodel", "pfifo", "red-ecn"]
+SOJOURN = re.compile(r"^sojourn(\w*?)P(50|90|99)Ms$")
+QUANTILE = re.compile(r"^queue(\w*?)P(50|90|99)$")
+
+
+def worst(summary, pattern, scale):
+    out = {}
+    for key, value in summary.items():
+        m = pattern.match(key)
+        if m:
+            q = int(m.group(2))
+            out[q] = max(out.get(q, 0.0), value * scale)
+    return out
+
+
+def delay_ms(summary):
+    """{50: ms, 90: ms, 99: ms} for the worst queue, empty when not derivable."""
+    measured = worst(summary, SOJOURN, 1.0)
+    if measured:
+        return measured
+    if not summary.get("linkBps") or not summary.get("packetBytes"):
+        return {}
+    return worst(summary, QUANTILE, summary["packetBytes"] * 8 / summary["linkBps"] * 1e3)
+
+
+def mean(values):
+    return sum(values) / len(values) if values else float("nan")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    add_common_arguments(parser)
+    parser.set_defaults(out="aqm-out")
+    parser.add_argument("--aqms", nargs="*", default=AQMS, help="queue disciplines to compare")
+    parser.add_argument("--seeds", nargs="*", type=int, default=[1], help="runNumber values, the same for every AQM")
+    parser.add_argument("--extra", nargs="*", default=[], help="extra --name=value options for every run")
+    parser.add_argument("--plot", help="also plot p99 delay against throughput into this image")
+    args = parser.parse_args()
+
+    unknown = [a for a in args.aqms if a not in AQMS]
+    if unknown:
+        sys.exit("unknown AQM %s, choose from %s" % (", ".join(unknown), ", ".join(AQMS)))
+
+    binary, env = find_program(args.ns3_dir, args.program)
+    extra = ["--writeForPlot=0", "--sojourn=1"] + list(args.extra)
+
+    tasks = []
+    for aqm in args.aqms:
+        for seed in args.seeds:
+            params = {"aqm": "red", "ecn": 1} if aqm == "red-ecn" else {"aqm": aqm}
+            params["runNumber"] = seed
+            tasks.append((len(tasks), aqm, params))
+
+    def worker(task):
+        index, _, params = task
+        outdir = os.path.abspath(os.path.join(args.out, "run-%04d" % index))
+        return run_one(binary, env, outdir, params, extra, args.timeout)
+
+    rows = []
+    start = time.time()
+    for (index, aqm, params), (summary, wall, status) in run_pool(tasks, args.jobs, worker):
+        row = {"run": index}
+        row.update(params)
+        row["aqm"] = aqm
+        for q, ms in sorted(delay_ms(summary).items()):
+            row["delayP%dMs" % q] = round(ms, 4)
+        row.update(summary)
+        row["wallSeconds"] = round(wall, 3)
+        row["status"] = status
+        rows.append(row)
+
+    rows.sort(key=lambda r: r["run"])
+    os.makedirs(args.out, exist_ok=True)
+    write_table(os.path.join(args.out, "aqm.csv"), rows)
+    print("%d runs in %.1f s, results in %s\n" % (len(rows), time.time() - start, os.path.join(args.out, "aqm.csv")))
+
+    print("%-8s %5s %10s %8s %8s %10s %10s %10s" % ("aqm", "runs", "thr Mb/s", "drops", "marks", "p50 ms", "p90 ms",
+                                                    "p99 ms"))
+    points = []
+    for aqm in args.aqms:
+        ok = [r for r in rows if r["aqm"] == aqm and r["status"] == "ok"]
+        thr = mean([r["throughputMbps"] for r in ok])
+        drops = mean([r["drops"] for r in ok])
+        marks = mean([r.get("marks", 0) for r in ok])
+        delay = [mean([r["delayP%dMs" % q] for r in ok if "delayP%dMs" % q in r]) for q in (50, 90, 99)]
+        print("%-8s %5d %10.2f %8.0f %8.0f %10.3f %10.3f %10.3f" % (aqm, len(ok), thr, drops, marks, delay[0], delay[1],
+                                                                  delay[2]))
+        if ok:
+            points.append((aqm, thr, delay[2]))
+
+    if args.plot and points:
+        import matplotlib
+        matplotlib.use("Agg")
+        import matplotlib.pyplot as plt
+
+        for aqm, thr, p99 in points:
+            plt.scatter(p99, thr)
+            plt.annotate(aqm, (p99, thr), textcoords="offset points", xytext=(4, 4))
+        plt.xlabel("p99 queueing delay (ms)")
+        plt.ylabel("Throughput (Mb/s)")
+        plt.title("%s, seeds %s" % (args.program, " ".join(str(s) for s in args.seeds)))
+        plt.grid(True)
+        plt.savefig(args.plot)
+        print("\nplot written to %s" % args.plot)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,116 @@
+#!/usr/bin/env python3
+"""Benchmarks the RED scenarios and flags regressions between commits.
+
+Runs p2a, p2b and p2c with --profile=1 at several stop times (and p2c at
+several edge-node counts, i.e. flow counts), one run at a time so the
+timings do not disturb each other. Every row of bench.csv holds the wall
+time, the simulator events per second, the peak RSS and the time spent in
+each trace callback, as reported by red-profile.h.
+
+    python3 redbench.py --ns3-dir ~/ns-3.27 --out bench-new
+    python3 redbench.py --ns3-dir ~/ns-3.27 --out bench-new --baseline bench-old/bench.csv
+
+With --baseline the median wall time of every case is compared with the
+same case in the older file; the script exits with status 1 if any case is
+slower than --threshold allows.
+"""
+
+import argparse
+import csv
+import os
+import statistics
+import sys
+import time
+
+from redsweep import find_program, run_one, run_pool, write_table
+
+
+def cases(programs, stop_times, edge_nodes):
+    for program in programs:
+        for stop in stop_times:
+            if program == "p2c":
+                for edges in edge_nodes:
+                    yield program, {"stopTime": stop, "edgeNodes": edges}
+            else:
+                yield program, {"stopTime": stop}
+
+
+def case_key(row):
+    return (row["program"], str(float(row["stopTime"])), str(row.get("edgeNodes", "")))
+
+
+def median_wall(rows):
+    groups = {}
+    for row in rows:
+        if row.get("status", "ok") == "ok":
+            groups.setdefault(case_key(row), []).append(float(row["wallSeconds"]))
+    return dict((k, statistics.median(v)) for k, v in groups.items())
+
+
+def compare(rows, baseline_path, threshold):
+    with open(baseline_path) as f:
+        old = median_wall(list(csv.DictReader(f)))
+    new = median_wall(rows)
+    regressions = 0
+    for key in sorted(new):
+        if key not in old:
+            continue
+        change = new[key] / old[key] - 1 if old[key] > 0 else 0.0
+        flag = "REGRESSION" if change > threshold else ""
+        regressions += 1 if flag else 0
+        print("%-4s stop=%-6s edges=%-5s %8.3f s -> %8.3f s  %+6.1f%% %s" % (key[0], key[1], key[2] or "-", old[key],
+                                                                         new[key], 100 * change, flag))
+    return regressions
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--ns3-dir", default=".", help="ns-3 source tree the scenarios were built in")
+    parser.add_argument("--programs", nargs="*", default=["p2a", "p2b", "p2c"])
+    parser.add_argument("--stop-times", nargs="*", type=float, default=[1.0, 5.0])
+    parser.add_argument("--edge-nodes", nargs="*", type=int, default=[4, 16, 64],
+                        help="p2c --edgeNodes values; flows = 2 * edgeNodes * flowsPerNode")
+    parser.add_argument("--repeat", type=int, default=3, help="runs per case, the median is compared")
+    parser.add_argument("--jobs", type=int, default=1, help="concurrent runs (keep 1 for stable timings)")
+    parser.add_argument("--extra", nargs="*", default=[], help="extra --name=value options for every run")
+    parser.add_argument("--out", default="bench-out", help="directory for per-run outputs and bench.csv")
+    parser.add_argument("--baseline", help="bench.csv of an earlier commit to compare against")
+    parser.add_argument("--threshold", type=float, default=0.10, help="allowed slowdown before flagging (0.10 = 10%%)")
+    args = parser.parse_args()
+
+    binaries = dict((p, find_program(args.ns3_dir, p)) for p in args.programs)
+    extra = ["--profile=1", "--writeForPlot=1"] + list(args.extra)
+
+    tasks = []
+    for program, params in cases(args.programs, args.stop_times, args.edge_nodes):
+        for rep in range(args.repeat):
+            tasks.append((len(tasks), program, rep, params))
+
+    def worker(task):
+        index, program, rep, params = task
+        binary, env = binaries[program]
+        outdir = os.path.abspath(os.path.join(args.out, "run-%04d" % index))
+        return run_one(binary, env, outdir, params, extra)
+
+    rows = []
+    start = time.time()
+    for (index, program, rep, params), (summary, wall, status) in run_pool(tasks, args.jobs, worker):
+        row = {"run": index, "program": program, "repeat": rep}
+        row.update(params)
+        row["wallSeconds"] = round(wall, 3)
+        row["status"] = status
+        row.update(summary)
+        rows.append(row)
+
+    rows.sort(key=lambda r: r["run"])
+    os.makedirs(args.out, exist_ok=True)
+    write_table(os.path.join(args.out, "bench.csv"), rows)
+    print("%d runs in %.1f s, results in %s" % (len(rows), time.time() - start, os.path.join(args.out, "bench.csv")))
+
+    if args.baseline:
+        if compare(rows, args.baseline, args.threshold) > 0:
+            sys.exit(1)
+
+
+if __name__ == "__main__":
+    main()
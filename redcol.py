@@ -0,0 +1,124 @@
+#!/usr/bin/env python3
+"""Loads RED scenario traces into NumPy arrays.
+
+    import redcol
+    q = redcol.load("P2c/redQueueA.rcol")       # {'time': ..., 'value': ...}
+    p = redcol.series("P2c", "PacketNumA", ["time", "seq"])
+
+load() reads the columnar .rcol files (--traceFormat=columnar, see
+red-columnar.h) and the fixed-record .bin files (--traceFormat=binary).
+The file is memory-mapped and every column is decoded with vectorised
+NumPy operations (varint split, zigzag, prefix sum or prefix XOR), so
+traces of long runs load in seconds.
+
+series() picks whichever of <name>.rcol, <name>.bin or <name>.plot exists
+in a directory, so the plot scripts work with any --traceFormat.
+
+    python3 redcol.py P2c/PacketNumA.rcol      # prints columns and row count
+"""
+
+import os
+import struct
+import sys
+
+import numpy as np
+
+TIME_NS, INT, FLOAT_XOR = 1, 2, 3
+PACKET, SAMPLE = 1, 2
+COL_SEQ, COL_PORT, COL_QUEUE = 1, 2, 4
+
+
+def _varints(buf):
+    """Decodes a byte array of LEB128 varints into uint64 values."""
+    if len(buf) == 0:
+        return np.zeros(0, dtype=np.uint64)
+    last = (buf & 0x80) == 0
+    ends = np.flatnonzero(last)
+    starts = np.concatenate(([0], ends[:-1] + 1))
+    group = np.concatenate(([0], np.cumsum(last[:-1])))
+    shift = (np.arange(len(buf)) - starts[group]) * 7
+    parts = (buf & 0x7f).astype(np.uint64) << shift.astype(np.uint64)
+    return np.add.reduceat(parts, starts)
+
+
+def _unzigzag(v):
+    return (v >> np.uint64(1)).astype(np.int64) ^ -(v & np.uint64(1)).astype(np.int64)
+
+
+def _decode(encoding, buf):
+    v = _varints(buf)
+    if encoding == FLOAT_XOR:
+        return np.bitwise_xor.accumulate(v).view(np.float64)
+    values = np.cumsum(_unzigzag(v))
+    if encoding == TIME_NS:
+        return values / 1e9
+    return values
+
+
+def _load_rcol(data):
+    magic, version, kind, text_columns, count = struct.unpack_from("<4sHHII", data, 0)
+    pos = 16
+    names = []
+    for _ in range(count):
+        names.append(bytes(data[pos:pos + 12]).split(b"\0")[0].decode())
+        pos += 16
+
+    parts = dict((n, []) for n in names)
+    while pos < len(data):
+        rows = struct.unpack_from("<I", data, pos)[0]
+        info = struct.unpack_from("<%dI" % (2 * count), data, pos + 4)
+        pos += 4 + 8 * count
+        for c, name in enumerate(names):
+            encoding, size = info[2 * c], info[2 * c + 1]
+            column = _decode(encoding, data[pos:pos + size])
+            if len(column) != rows:
+                raise ValueError("corrupt block in column %s" % name)
+            parts[name].append(column)
+            pos += size
+
+    out = {}
+    for name in names:
+        out[name] = np.concatenate(parts[name]) if parts[name] else np.zeros(0)
+    return out
+
+
+def _load_bin(data):
+    magic, version, kind, columns, record_size = struct.unpack_from("<4sHHII", data, 0)
+    if kind == PACKET:
+        dtype = np.dtype([("time", "<f8"), ("seq", "<u4"), ("port", "<u2"), ("queue", "<u2")])
+    else:
+        dtype = np.dtype([("time", "<f8"), ("value", "<f8")])
+    records = np.frombuffer(data, dtype=dtype, offset=16)
+    return dict((name, records[name]) for name in dtype.names)
+
+
+def load(path):
+    """Returns {column name: array} for an .rcol or .bin trace."""
+    data = np.memmap(path, dtype=np.uint8, mode="r")
+    magic = bytes(data[:4])
+    if magic == b"RCOL":
+        return _load_rcol(data)
+    if magic == b"REDT":
+        return _load_bin(data)
+    raise ValueError("%s is not a RED trace file" % path)
+
+
+def series(directory, name, text_names):
+    """Loads <directory>/<name> in whichever format it was written.
+
+    text_names names the whitespace separated columns of the .plot file,
+    e.g. ["time", "seq", "port"]; they are used only for text traces.
+    """
+    base = os.path.join(directory, name)
+    for ext in (".rcol", ".bin"):
+        if os.path.exists(base + ext):
+            return load(base + ext)
+    table = np.loadtxt(base + ".plot", ndmin=2)
+    return dict((n, table[:, i] if table.size else np.zeros(0)) for i, n in enumerate(text_names))
+
+
+if __name__ == "__main__":
+    for path in sys.argv[1:]:
+        columns = load(path)
+        rows = len(next(iter(columns.values()))) if columns else 0
+        print("%s: %d rows, columns %s" % (path, rows, ", ".join(columns)))
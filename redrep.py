@@ -0,0 +1,138 @@
+#!/usr/bin/env python3
+"""Replicates one RED scenario over independent seeds until the results are tight.
+
+Runs the program with runNumber 1, 2, 3, ... (and --startJitter, so the
+replications differ), --jobs of them at a time. After every batch it
+computes the mean and the 95% confidence interval (Student t) of every
+summary value and stops once the --metrics all have a half-width below
+--target of their mean, or --max-runs is reached:
+
+    python3 redrep.py --ns3-dir ~/ns-3.27 --program p2a --target 0.02
+    python3 redrep.py --ns3-dir ~/ns-3.27 --program p2c --params minTh=10 maxTh=30 --metrics throughputMbps dropRate
+
+dropRate is derived from the summary: drops over the packets that arrived
+at the monitored queues. Seeds are used in order and the stopping rule is
+only checked between batches, so a given --jobs always runs the same
+seeds. Every run goes to <out>/replications.csv, the intervals to
+<out>/ci.csv.
+"""
+
+import argparse
+import math
+import os
+import re
+import time
+
+from redsweep import add_common_arguments, find_program, run_one, run_pool, write_table
+
+# Two-sided 95% Student t quantiles by degrees of freedom
+T95 = [12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+       2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+       2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042]
+ARRIVALS = re.compile(r"^queue\w*Arrivals$")
+
+
+def t95(df):
+    if df <= len(T95):
+        return T95[df - 1]
+    return 1.960 + 2.4 / df
+
+
+def add_derived(summary):
+    arrivals = sum(v for k, v in summary.items() if ARRIVALS.match(k))
+    if arrivals > 0 and "drops" in summary:
+        summary["dropRate"] = summary["drops"] / arrivals
+
+
+def interval(values):
+    """(mean, standard deviation, 95% half-width); the width is infinite below two values."""
+    n = len(values)
+    mean = sum(values) / n
+    if n < 2:
+        return mean, 0.0, float("inf")
+    sd = math.sqrt(sum((v - mean) ** 2 for v in values) / (n - 1))
+    return mean, sd, t95(n - 1) * sd / math.sqrt(n)
+
+
+def intervals(rows):
+    keys = []
+    for row in rows:
+        for k, v in row.items():
+            if k not in keys and isinstance(v, float):
+                keys.append(k)
+    out = []
+    for key in keys:
+        values = [r[key] for r in rows if key in r]
+        mean, sd, half = interval(values)
+        rel = half / abs(mean) if mean else (0.0 if half == 0 else float("inf"))
+        out.append({"metric": key, "n": len(values), "mean": mean, "sd": sd, "halfWidth": half, "relHalfWidth": rel})
+    return out
+
+
+def converged(cis, metrics, target):
+    by_name = dict((c["metric"], c) for c in cis)
+    return all(m in by_name and by_name[m]["relHalfWidth"] <= target for m in metrics)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    add_common_arguments(parser)
+    parser.set_defaults(out="rep-out")
+    parser.add_argument("--params", nargs="*", default=[], help="name=value program options for every run")
+    parser.add_argument("--start-jitter", type=float, default=0.1, help="--startJitter of every run (seconds)")
+    parser.add_argument("--metrics", nargs="*", default=["throughputMbps", "dropRate", "meanQueue"],
+                        help="summary values whose intervals must reach --target")
+    parser.add_argument("--target", type=float, default=0.05, help="relative 95%% half-width to stop at (0.05 = 5%%)")
+    parser.add_argument("--min-runs", type=int, default=3)
+    parser.add_argument("--max-runs", type=int, default=100)
+    args = parser.parse_args()
+
+    binary, env = find_program(args.ns3_dir, args.program)
+    params = dict(p.split("=", 1) for p in args.params)
+    params["startJitter"] = args.start_jitter
+    extra = ["--writeForPlot=0"]
+
+    def worker(seed):
+        outdir = os.path.abspath(os.path.join(args.out, "seed-%04d" % seed))
+        run = dict(params)
+        run["runNumber"] = seed
+        return run_one(binary, env, outdir, run, extra, args.timeout)
+
+    rows = []
+    failed = 0
+    seed = 1
+    cis = []
+    start = time.time()
+    while seed <= args.max_runs:
+        batch = list(range(seed, min(seed + max(args.jobs, 1), args.max_runs + 1)))
+        seed = batch[-1] + 1
+        for run_seed, (summary, wall, status) in run_pool(batch, args.jobs, worker, progress=False):
+            if status != "ok":
+                failed += 1
+                continue
+            add_derived(summary)
+            row = dict(summary)
+            row["runNumber"] = run_seed
+            row["wallSeconds"] = round(wall, 3)
+            rows.append(row)
+
+        rows.sort(key=lambda r: r["runNumber"])
+        if not rows:
+            continue
+        cis = intervals(rows)
+        shown = [c for c in cis if c["metric"] in args.metrics]
+        print("%3d runs: %s" % (len(rows), "  ".join("%s %.4g +- %.2g" % (c["metric"], c["mean"], c["halfWidth"])
+                                                   for c in shown)))
+        if len(rows) >= args.min_runs and converged(cis, args.metrics, args.target):
+            break
+
+    os.makedirs(args.out, exist_ok=True)
+    write_table(os.path.join(args.out, "replications.csv"), rows)
+    write_table(os.path.join(args.out, "ci.csv"), cis)
+    state = "converged" if cis and converged(cis, args.metrics, args.target) else "did not converge"
+    print("%s after %d runs (%d failed) in %.1f s, intervals in %s" % (state, len(rows), failed, time.time() - start,
+                                                                     os.path.join(args.out, "ci.csv")))
+
+
+if __name__ == "__main__":
+    main()
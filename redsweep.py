@@ -0,0 +1,315 @@
+#!/usr/bin/env python3
+"""Parallel parameter sweep over the RED scenarios.
+
+Runs one of the scenario programs (p2a, p2b, p2c, ...) once per RED
+configuration and seed, as a pool of processes across all cores. Every run
+gets its own output directory holding the summary.txt written by
+--writeSummary; the summaries are collected into one results.csv.
+
+Examples:
+    python3 redsweep.py --ns3-dir ~/ns-3.27 --program p2a \\
+        --grid minTh=5,10,15 maxTh=15,30,60 qw=0.002,0.02 --seeds 1 2 3
+    python3 redsweep.py --ns3-dir ~/ns-3.27 --program p2c --list points.csv
+
+A --list file is a CSV whose header names program options (minTh, maxTh,
+qw, maxPackets, stopTime, ...) and whose rows are the points to run.
+
+With --fork-at T, points that differ only in qw and the seed share one
+process: it simulates the first T seconds once and forks a child per
+variant (--forkVariants, see red-fork.h), whose statistics cover T to the
+stop time only:
+
+    python3 redsweep.py --ns3-dir ~/ns-3.27 --program p2b \\
+        --grid minTh=15,30 qw=0.001,0.002,0.005,0.01 --seeds 1 2 3 4 --fork-at 0.3
+"""
+
+import argparse
+import csv
+import glob
+import itertools
+import os
+import subprocess
+import sys
+import time
+from concurrent.futures import ThreadPoolExecutor, as_completed
+
+
+def find_program(ns3_dir, program):
+    """Returns the built scenario binary and the environment to run it in."""
+    if os.path.isfile(program) and os.access(program, os.X_OK):
+        binary = program
+    else:
+        candidates = [os.path.join(ns3_dir, "build", "scratch", program)]
+        candidates += sorted(glob.glob(os.path.join(ns3_dir, "build", "scratch", "*" + program + "*")))
+        binary = next((c for c in candidates if os.path.isfile(c) and os.access(c, os.X_OK)), None)
+        if binary is None:
+            sys.exit("cannot find a built '%s' under %s/build/scratch (run ./waf build first)" % (program, ns3_dir))
+
+    env = dict(os.environ)
+    libdir = os.path.join(ns3_dir, "build", "lib")
+    env["LD_LIBRARY_PATH"] = libdir + os.pathsep + env.get("LD_LIBRARY_PATH", "")
+    return os.path.abspath(binary), env
+
+
+def parse_grid(items):
+    """['minTh=5,10', 'qw=0.002'] -> list of dicts, the cartesian product."""
+    names = []
+    values = []
+    for item in items:
+        name, _, vals = item.partition("=")
+        if not vals:
+            sys.exit("bad --grid entry '%s', expected name=v1,v2,..." % item)
+        names.append(name)
+        values.append(vals.split(","))
+    return [dict(zip(names, combo)) for combo in itertools.product(*values)]
+
+
+def read_list(path):
+    with open(path) as f:
+        return [dict((k, v) for k, v in row.items() if v != "") for row in csv.DictReader(f)]
+
+
+def read_summary(path):
+    summary = {}
+    with open(path) as f:
+        for line in f:
+            key, _, value = line.partition(" ")
+            if value:
+                summary[key] = float(value)
+    return summary
+
+
+def valid_point(params):
+    if "minTh" in params and "maxTh" in params:
+        return float(params["minTh"]) < float(params["maxTh"])
+    return True
+
+
+# Values a --forkVariants child can still change after the warm-up
+FORKABLE = ("qw", "runNumber")
+
+
+def launch(binary, env, outdir, params, extra_args=(), timeout=None):
+    """Runs one scenario process in outdir and returns (exit code or "timeout", wall seconds)."""
+    os.makedirs(outdir, exist_ok=True)
+    args = [binary, "--pathOut=" + outdir, "--writeSummary=1"]
+    args += ["--%s=%s" % (k, v) for k, v in params.items()]
+    args += list(extra_args)
+    start = time.time()
+    with open(os.path.join(outdir, "stdout.txt"), "w") as out:
+        try:
+            rc = subprocess.call(args, stdout=out, stderr=subprocess.STDOUT, env=env, cwd=outdir, timeout=timeout)
+        except subprocess.TimeoutExpired:
+            rc = "timeout"
+    return rc, time.time() - start
+
+
+def run_one(binary, env, outdir, params, extra_args=(), timeout=None):
+    """Runs one scenario into outdir and returns (summary dict, wall seconds, status)."""
+    summary_path = os.path.join(outdir, "summary.txt")
+    if os.path.exists(summary_path):
+        os.remove(summary_path)
+    rc, wall = launch(binary, env, outdir, params, extra_args, timeout)
+    if rc != 0 or not os.path.exists(summary_path):
+        return {}, wall, "failed(%s)" % rc
+    return read_summary(summary_path), wall, "ok"
+
+
+def run_forked(binary, env, outdir, params, variants, warmup, fork_jobs, extra_args=(), timeout=None):
+    """Runs one warm-up forked into variants (dicts of FORKABLE values).
+
+    Returns a (summary dict, status) pair per variant and the wall seconds
+    of the whole process.
+    """
+    spec = ";".join(",".join("%s=%s" % kv for kv in sorted(v.items())) for v in variants)
+    fork_args = ["--forkVariants=" + spec, "--warmup=%g" % warmup, "--forkJobs=%d" % fork_jobs]
+    # The variant directories are reused, so a summary left by an earlier
+    # invocation would pass for this one's
+    for path in glob.glob(os.path.join(outdir, "variant-*", "summary.txt")):
+        os.remove(path)
+    rc, wall = launch(binary, env, outdir, params, list(extra_args) + fork_args, timeout)
+    results = []
+    for i in range(len(variants)):
+        path = os.path.join(outdir, "variant-%03d" % i, "summary.txt")
+        if os.path.exists(path):
+            results.append((read_summary(path), "ok"))
+        else:
+            results.append(({}, "failed(%s)" % rc))
+    for i in unchanged_ewma(variants, results):
+        results[i] = (results[i][0], "ewma-unchanged")
+    return results, wall
+
+
+def unchanged_ewma(variants, results):
+    """Indices of forked variants whose queue EWMAs equal those of a variant
+    that differs only in qw, i.e. whose child kept the parent's weight."""
+    bad = set()
+    for i, j in itertools.combinations(range(len(variants)), 2):
+        a, b = variants[i], variants[j]
+        if a.get("qw") == b.get("qw") or a.get("runNumber") != b.get("runNumber"):
+            continue
+        if results[i][1] != "ok" or results[j][1] != "ok":
+            continue
+        ewma = [k for k in results[i][0] if k.startswith("queue") and k.endswith("Ewma")]
+        if ewma and all(results[i][0][k] == results[j][0].get(k) for k in ewma):
+            bad.update((i, j))
+    return sorted(bad)
+
+
+def fork_groups(points, seeds):
+    """Splits every (point, seed) run into a shared part and its FORKABLE variant.
+
+    Returns [(shared params, [variant, ...])], one entry per warm-up.
+    """
+    groups = []
+    by_key = {}
+    for point in points:
+        shared = dict((k, v) for k, v in point.items() if k not in FORKABLE)
+        key = tuple(sorted(shared.items()))
+        if key not in by_key:
+            by_key[key] = len(groups)
+            groups.append((shared, []))
+        for seed in seeds:
+            variant = dict((k, v) for k, v in point.items() if k in FORKABLE)
+            variant["runNumber"] = seed
+            groups[by_key[key]][1].append(variant)
+    return groups
+
+
+def run_pool(tasks, jobs, worker, progress=True):
+    """Runs worker(task) for every task on a pool of jobs and yields (task, result) as they finish.
+
+    The scenarios are separate processes, so threads are enough to keep
+    every core busy.
+    """
+    done = 0
+    with ThreadPoolExecutor(max_workers=jobs) as pool:
+        futures = dict((pool.submit(worker, task), task) for task in tasks)
+        for future in as_completed(futures):
+            done += 1
+            if progress:
+                sys.stderr.write("\r%d/%d runs done" % (done, len(tasks)))
+                sys.stderr.flush()
+            yield futures[future], future.result()
+    if progress:
+        sys.stderr.write("\n")
+
+
+def write_table(path, rows):
+    keys = []
+    for row in rows:
+        for k in row:
+            if k not in keys:
+                keys.append(k)
+    with open(path, "w", newline="") as f:
+        writer = csv.DictWriter(f, fieldnames=keys)
+        writer.writeheader()
+        for row in rows:
+            writer.writerow(row)
+
+
+def add_common_arguments(parser):
+    parser.add_argument("--ns3-dir", default=".", help="ns-3 source tree the scenarios were built in")
+    parser.add_argument("--program", default="p2a", help="scenario name (p2a, p2b, p2c, ...) or path to a binary")
+    parser.add_argument("--jobs", type=int, default=os.cpu_count(), help="concurrent runs (default: all cores)")
+    parser.add_argument("--timeout", type=float, default=None, help="seconds before a run is killed")
+    parser.add_argument("--out", default="sweep-out", help="directory for per-run outputs and results.csv")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    add_common_arguments(parser)
+    parser.add_argument("--grid", nargs="*", default=[], help="name=v1,v2,... entries, swept as a cartesian product")
+    parser.add_argument("--list", help="CSV file listing the points to run")
+    parser.add_argument("--seeds", nargs="*", type=int, default=[1], help="runNumber values run for every point")
+    parser.add_argument("--plots", action="store_true", help="also write the .plot traces for every run")
+    parser.add_argument("--links", action="store_true", help="also write links.txt and the top congested links "
+                        "(--writeLinks) for every run")
+    parser.add_argument("--fork-at", type=float, help="simulate this many seconds once per group of points that "
+                        "differ only in qw and seed, then fork the rest of every run from there")
+    args = parser.parse_args()
+
+    points = read_list(args.list) if args.list else []
+    if args.grid:
+        points += parse_grid(args.grid)
+    if not points:
+        points = [{}]
+    points = [p for p in points if valid_point(p)]
+
+    binary, env = find_program(args.ns3_dir, args.program)
+    extra = [] if args.plots else ["--writeForPlot=0"]
+    if args.links:
+        extra.append("--writeLinks=1")
+
+    if args.fork_at:
+        if args.links:
+            sys.exit("--links cannot be combined with --fork-at, the children would share links.txt")
+        sweep_forked(args, points, binary, env)
+        return
+
+    tasks = []
+    for point in points:
+        for seed in args.seeds:
+            params = dict(point)
+            params["runNumber"] = seed
+            tasks.append((len(tasks), params))
+
+    def worker(task):
+        index, params = task
+        outdir = os.path.abspath(os.path.join(args.out, "run-%04d" % index))
+        return run_one(binary, env, outdir, params, extra, args.timeout)
+
+    rows = []
+    start = time.time()
+    for (index, params), (summary, wall, status) in run_pool(tasks, args.jobs, worker):
+        row = {"run": index}
+        row.update(params)
+        row.update(summary)
+        row["wallSeconds"] = round(wall, 3)
+        row["status"] = status
+        rows.append(row)
+
+    rows.sort(key=lambda r: r["run"])
+    os.makedirs(args.out, exist_ok=True)
+    write_table(os.path.join(args.out, "results.csv"), rows)
+    failed = sum(1 for r in rows if r["status"] != "ok")
+    print("%d runs (%d failed) in %.1f s, results in %s" % (len(rows), failed, time.time() - start,
+                                                          os.path.join(args.out, "results.csv")))
+
+
+def sweep_forked(args, points, binary, env):
+    groups = fork_groups(points, args.seeds)
+    # Every process runs up to fork_jobs children, so fewer processes at once
+    fork_jobs = max(1, min(args.jobs, max(len(v) for _, v in groups)))
+    tasks = list(enumerate(groups))
+
+    def worker(task):
+        index, (shared, variants) = task
+        outdir = os.path.abspath(os.path.join(args.out, "group-%04d" % index))
+        return run_forked(binary, env, outdir, shared, variants, args.fork_at, fork_jobs, ["--writeForPlot=0"],
+                          args.timeout)
+
+    rows = []
+    start = time.time()
+    for (index, (shared, variants)), (results, wall) in run_pool(tasks, max(1, args.jobs // fork_jobs), worker):
+        for i, (summary, status) in enumerate(results):
+            row = {"run": len(rows), "group": index, "variant": i}
+            row.update(shared)
+            row.update(variants[i])
+            row.update(summary)
+            row["wallSeconds"] = round(wall / len(variants), 3)
+            row["status"] = status
+            rows.append(row)
+
+    rows.sort(key=lambda r: (r["group"], r["variant"]))
+    for run, row in enumerate(rows):
+        row["run"] = run
+    os.makedirs(args.out, exist_ok=True)
+    write_table(os.path.join(args.out, "results.csv"), rows)
+    failed = sum(1 for r in rows if r["status"] != "ok")
+    print("%d runs (%d failed) forked from %d warm-ups in %.1f s, results in %s"
+          % (len(rows), failed, len(groups), time.time() - start, os.path.join(args.out, "results.csv")))
+
+
+if __name__ == "__main__":
+    main()